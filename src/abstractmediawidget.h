@@ -51,6 +51,7 @@ public:
 	int getCurrentAngle() const { return currentAngle; }
 	bool hasDvdMenu() const { return dvdMenu; }
 	QSize getVideoSize() const { return videoSize; }
+	virtual bool supportsStreams() const { return false; } // see MediaStream
 
 	virtual QStringList getAudioDevices() = 0;
 	virtual void setAudioDevice(QString device) = 0;
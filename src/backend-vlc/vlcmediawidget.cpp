@@ -22,6 +22,7 @@
 
 #include <QApplication>
 #include <QCursor>
+#include <QFileInfo>
 #include <QMouseEvent>
 #include <QTimer>
 #include <QMap>
@@ -165,10 +166,40 @@ const char *vlcEventName(int event)
 	}
 }
 
+#if LIBVLC_VERSION_MAJOR > 2
+// custom i/o callbacks (see MediaStream)
+
+static int vlcStreamOpen(void *opaque, void **datap, uint64_t *sizep)
+{
+	MediaStream *stream = static_cast<MediaStream *>(opaque);
+	*datap = stream;
+	*sizep = UINT64_MAX; // unknown size
+	return (stream->open() ? 0 : -1);
+}
+
+static ssize_t vlcStreamRead(void *opaque, unsigned char *buf, size_t len)
+{
+	MediaStream *stream = static_cast<MediaStream *>(opaque);
+	return ssize_t(stream->read(reinterpret_cast<char *>(buf), qint64(len)));
+}
+
+static int vlcStreamSeek(void *opaque, uint64_t offset)
+{
+	MediaStream *stream = static_cast<MediaStream *>(opaque);
+	return (stream->seek(offset) ? 0 : -1);
+}
+
+static void vlcStreamClose(void *opaque)
+{
+	static_cast<MediaStream *>(opaque)->close();
+}
+#endif /* LIBVLC_VERSION_MAJOR */
+
 VlcMediaWidget::VlcMediaWidget(QWidget *parent) : AbstractMediaWidget(parent),
     timer(NULL), vlcInstance(NULL), vlcMedia(NULL), vlcMediaPlayer(NULL),
     isPaused(false), playingDvd(false), urlIsAudioCd(false),
-    typeOfDevice(""), trackNumber(1), numTracks(1)
+    typeOfDevice(""), trackNumber(1), numTracks(1), mediaStream(NULL),
+    restartingStream(false)
 {
 	libvlc_event_e events[] = {
 		libvlc_MediaPlayerEncounteredError,
@@ -484,6 +515,15 @@ void VlcMediaWidget::setDeinterlacing(MediaWidget::DeinterlaceMode deinterlacing
 	libvlc_video_set_deinterlace(vlcMediaPlayer, vlcDeinterlaceMode);
 }
 
+bool VlcMediaWidget::supportsStreams() const
+{
+#if LIBVLC_VERSION_MAJOR > 2
+	return true;
+#else
+	return false;
+#endif
+}
+
 void VlcMediaWidget::play(const MediaSource &source)
 {
 	addPendingUpdates(PlaybackStatus | DvdMenu);
@@ -533,12 +573,31 @@ void VlcMediaWidget::play(const MediaSource &source)
 
 	typeOfDevice = url.constData();
 
+	// recordings and time shift files may have a seek index
+	localFileName = source.getUrl().isLocalFile() ? source.getUrl().toLocalFile() : QString();
+	seekIndex.close();
+
+	if (!localFileName.isEmpty()) {
+		seekIndex.open(SeekIndexWriter::indexFileName(localFileName));
+	}
+
 	if (vlcMedia != NULL) {
-		libvlc_media_player_stop(vlcMediaPlayer);
+		stopPlayer();
 		libvlc_media_release(vlcMedia);
 	}
 
+	mediaStream = (supportsStreams() ? source.getStream() : NULL);
+
+#if LIBVLC_VERSION_MAJOR > 2
+	if (mediaStream != NULL) {
+		vlcMedia = libvlc_media_new_callbacks(vlcInstance, vlcStreamOpen, vlcStreamRead,
+			vlcStreamSeek, vlcStreamClose, mediaStream);
+	} else {
+		vlcMedia = libvlc_media_new_location(vlcInstance, typeOfDevice);
+	}
+#else
 	vlcMedia = libvlc_media_new_location(vlcInstance, typeOfDevice);
+#endif
 	if (urlIsAudioCd)
 		libvlc_media_add_option(vlcMedia, "cdda-track=1");
 
@@ -659,7 +718,8 @@ void VlcMediaWidget::playDirection(int direction)
 
 void VlcMediaWidget::stop()
 {
-	libvlc_media_player_stop(vlcMediaPlayer);
+	stopPlayer();
+	mediaStream = NULL;
 
 	if (vlcMedia != NULL) {
 		libvlc_media_release(vlcMedia);
@@ -686,6 +746,41 @@ void VlcMediaWidget::seek(int time)
 	if (!seekable)
 		return;
 
+	if (mediaStream != NULL) {
+		// vlc would continue with the data in its caches; the player is restarted,
+		// so that it reads from the new position of the stream
+		restartingStream = true;
+		stopPlayer();
+		restartingStream = false;
+		mediaStream->seekTime(time);
+
+		if (libvlc_media_player_play(vlcMediaPlayer) < 0) {
+			stop();
+			return;
+		}
+
+		if (isPaused) {
+			libvlc_media_player_set_pause(vlcMediaPlayer, true);
+		}
+
+		setMouseTracking(true);
+		addPendingUpdates(CurrentTotalTime);
+		return;
+	}
+
+	if (seekIndex.isOpen()) {
+		// the file may still be growing
+		seekIndex.update();
+		qint64 offset = seekIndex.findOffset(time);
+		qint64 size = QFileInfo(localFileName).size();
+
+		if ((offset >= 0) && (size > 0)) {
+			libvlc_media_player_set_position(vlcMediaPlayer,
+				float(double(offset) / double(size)));
+			return;
+		}
+	}
+
 	libvlc_media_player_set_time(vlcMediaPlayer, time);
 }
 
@@ -840,7 +935,7 @@ int VlcMediaWidget::updatePlaybackStatus()
 	case libvlc_Error:
 		playbackStatus = MediaWidget::Idle;
 		// don't keep last picture shown
-		libvlc_media_player_stop(vlcMediaPlayer);
+		stopPlayer();
 		break;
 	}
 
@@ -858,6 +953,11 @@ void VlcMediaWidget::updateCurrentTotalTime()
 	if (playbackStatus == MediaWidget::Idle)
 		return;
 
+	if (mediaStream != NULL) {
+		mediaStream->getCurrentTotalTime(currentTime, totalTime);
+		return;
+	}
+
 	currentTime = int(libvlc_media_player_get_time(vlcMediaPlayer));
 	totalTime = int(libvlc_media_player_get_length(vlcMediaPlayer));
 
@@ -876,7 +976,7 @@ void VlcMediaWidget::updateCurrentTotalTime()
 
 void VlcMediaWidget::updateSeekable()
 {
-	seekable = libvlc_media_player_is_seekable(vlcMediaPlayer);
+	seekable = ((mediaStream != NULL) || libvlc_media_player_is_seekable(vlcMediaPlayer));
 }
 
 void VlcMediaWidget::updateMetadata()
@@ -1075,6 +1175,12 @@ void VlcMediaWidget::vlcEvent(const libvlc_event_t *event)
 {
 	PendingUpdates pendingUpdatesToBeAdded = 0;
 
+	// stopping the player for a seek in a stream doesn't end the playback
+	if (restartingStream && ((event->type == libvlc_MediaPlayerEndReached) ||
+	    (event->type == libvlc_MediaPlayerStopped))) {
+		return;
+	}
+
 	switch (event->type) {
 #if LIBVLC_VERSION_MAJOR > 2
 	case libvlc_MediaPlayerESAdded:
@@ -1112,6 +1218,16 @@ void VlcMediaWidget::vlcEvent(const libvlc_event_t *event)
 	}
 }
 
+void VlcMediaWidget::stopPlayer()
+{
+	// libvlc_media_player_stop() waits until a blocked read returns
+	if (mediaStream != NULL) {
+		mediaStream->abort();
+	}
+
+	libvlc_media_player_stop(vlcMediaPlayer);
+}
+
 void VlcMediaWidget::vlcEventHandler(const libvlc_event_t *event, void *instance)
 {
 	reinterpret_cast<VlcMediaWidget *>(instance)->vlcEvent(event);
@@ -24,6 +24,7 @@
 #include <vlc/vlc.h>
 
 #include "../abstractmediawidget.h"
+#include "../seekindex.h"
 
 class QTimer;
 
@@ -51,6 +52,7 @@ public:
 	void setAspectRatio(MediaWidget::AspectRatio aspectRatio) override;
 	void resizeToVideo(float resizeFactor) override;
 	void setDeinterlacing(MediaWidget::DeinterlaceMode deinterlacing) override;
+	bool supportsStreams() const override;
 	void play(const MediaSource &source) override;
 	void stop() override;
 	void setPaused(bool paused) override;
@@ -87,6 +89,7 @@ private:
 	void mouseMoveEvent(QMouseEvent *event) override;
 
 	void vlcEvent(const libvlc_event_t *event);
+	void stopPlayer();
 
 	static void vlcEventHandler(const libvlc_event_t *event, void *instance);
 
@@ -102,6 +105,10 @@ private:
 	QByteArray typeOfDevice;
 	int trackNumber, numTracks;
 	QVector<libvlc_event_e> eventType;
+	QString localFileName; // empty if not playing a local file
+	SeekIndex seekIndex;
+	MediaStream *mediaStream; // NULL if not playing a stream
+	bool restartingStream; // see seek()
 };
 
 #endif /* VLCMEDIAWIDGET_H */
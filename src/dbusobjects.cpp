@@ -23,6 +23,7 @@
 #include <QDBusMetaType>
 
 #include "dbusobjects.h"
+#include "dvb/dvbepg.h"
 #include "dvb/dvbmanager.h"
 #include "dvb/dvbtab.h"
 #include "playlist/playlisttab.h"
@@ -80,6 +81,26 @@ static const QDBusArgument &operator>>(const QDBusArgument &argument,
 	argument.endStructure();
 	return argument;
 }
+
+static QDBusArgument &operator<<(QDBusArgument &argument,
+	const TelevisionProgramGuideEntryStruct &entry)
+{
+	argument.beginStructure();
+	argument << entry.channel << entry.begin << entry.duration << entry.title <<
+		entry.subheading << entry.recordingKey;
+	argument.endStructure();
+	return argument;
+}
+
+static const QDBusArgument &operator>>(const QDBusArgument &argument,
+	TelevisionProgramGuideEntryStruct &entry)
+{
+	argument.beginStructure();
+	argument >> entry.channel >> entry.begin >> entry.duration >> entry.title >>
+		entry.subheading >> entry.recordingKey;
+	argument.endStructure();
+	return argument;
+}
 #endif
 
 MprisRootObject::MprisRootObject(QObject *parent) : QObject(parent)
@@ -324,6 +345,8 @@ DBusTelevisionObject::DBusTelevisionObject(DvbTab *dvbTab_, QObject *parent) : Q
 {
 	qDBusRegisterMetaType<TelevisionScheduleEntryStruct>();
 	qDBusRegisterMetaType<QList<TelevisionScheduleEntryStruct> >();
+	qDBusRegisterMetaType<TelevisionProgramGuideEntryStruct>();
+	qDBusRegisterMetaType<QList<TelevisionProgramGuideEntryStruct> >();
 }
 
 DBusTelevisionObject::~DBusTelevisionObject()
@@ -379,6 +402,12 @@ QList<TelevisionScheduleEntryStruct> DBusTelevisionObject::ListProgramSchedule()
 
 quint32 DBusTelevisionObject::ScheduleProgram(const QString &name, const QString &channel,
 	const QString &begin, const QString &duration, int repeat)
+{
+	return ScheduleProgram(name, channel, begin, duration, repeat, QString());
+}
+
+quint32 DBusTelevisionObject::ScheduleProgram(const QString &name, const QString &channel,
+	const QString &begin, const QString &duration, int repeat, const QString &profile)
 {
 	DvbRecording recording;
 	recording.name = name;
@@ -386,6 +415,7 @@ quint32 DBusTelevisionObject::ScheduleProgram(const QString &name, const QString
 	recording.begin = QDateTime::fromString(begin, Qt::ISODate).toUTC();
 	recording.duration = QTime::fromString(duration, Qt::ISODate);
 	recording.repeat = (repeat & ((1 << 7) - 1));
+	recording.profile = profile;
 	recording.disabled = false;
 	DvbSharedRecording newRecording =
 		dvbTab->getManager()->getRecordingModel()->addRecording(recording);
@@ -409,4 +439,71 @@ void DBusTelevisionObject::RemoveProgram(quint32 key)
 	}
 }
 
+static TelevisionProgramGuideEntryStruct programGuideEntry(const DvbSharedEpgEntry &epgEntry,
+	const QString &lang)
+{
+	TelevisionProgramGuideEntryStruct entry;
+	entry.channel = epgEntry->channel->name;
+	entry.begin = (epgEntry->begin.toString(Qt::ISODate) + QLatin1Char('Z'));
+	entry.duration = epgEntry->duration.toString(Qt::ISODate);
+	entry.title = epgEntry->title(lang);
+	entry.subheading = epgEntry->subheading(lang);
+	entry.recordingKey = 0;
+
+	if (epgEntry->recording.isValid()) {
+		entry.recordingKey = epgEntry->recording->sqlKey;
+	}
+
+	return entry;
+}
+
+static bool programGuideEntryLessThan(const DvbSharedEpgEntry &x, const DvbSharedEpgEntry &y)
+{
+	if (x->begin != y->begin) {
+		return (x->begin < y->begin);
+	}
+
+	return (x->channel->name < y->channel->name);
+}
+
+QList<TelevisionProgramGuideEntryStruct> DBusTelevisionObject::SearchProgramGuide(
+	const QString &query, const QString &language)
+{
+	QList<TelevisionProgramGuideEntryStruct> entries;
+	DvbManager *manager = dvbTab->getManager();
+	QList<DvbSharedEpgEntry> epgEntries = manager->getEpgModel()->findEntries(
+		DvbEpgTextIndex::tokenize(query), language.toUpper());
+	qSort(epgEntries.begin(), epgEntries.end(), programGuideEntryLessThan);
+	QString lang = language.isEmpty() ? manager->currentEpgLanguage : language.toUpper();
+
+	foreach (const DvbSharedEpgEntry &epgEntry, epgEntries) {
+		entries.append(programGuideEntry(epgEntry, lang));
+	}
+
+	return entries;
+}
+
+QList<TelevisionProgramGuideEntryStruct> DBusTelevisionObject::ListCurrentPrograms(
+	const QString &language)
+{
+	QList<TelevisionProgramGuideEntryStruct> entries;
+	DvbManager *manager = dvbTab->getManager();
+	QString lang = language.isEmpty() ? manager->currentEpgLanguage : language.toUpper();
+	QList<DvbSharedEpgEntry> epgEntries;
+
+	// one pass over the epg for all channels
+	foreach (const QList<DvbSharedEpgEntry> &currentNext,
+		 manager->getEpgModel()->getCurrentNext()) {
+		epgEntries.append(currentNext);
+	}
+
+	qSort(epgEntries.begin(), epgEntries.end(), programGuideEntryLessThan);
+
+	foreach (const DvbSharedEpgEntry &epgEntry, epgEntries) {
+		entries.append(programGuideEntry(epgEntry, lang));
+	}
+
+	return entries;
+}
+
 #endif /* HAVE_DVB == 1 */
@@ -31,6 +31,7 @@ class PlaylistTab;
 
 struct MprisStatusStruct;
 struct MprisVersionStruct;
+struct TelevisionProgramGuideEntryStruct;
 struct TelevisionScheduleEntryStruct;
 
 class MprisRootObject : public QObject
@@ -152,7 +153,16 @@ public slots:
 	QList<TelevisionScheduleEntryStruct> ListProgramSchedule();
 	quint32 ScheduleProgram(const QString &name, const QString &channel, const QString &begin,
 		const QString &duration, int repeat);
+	// 'profile' selects the recorded streams (see DvbRecordingProfile); empty = global
+	quint32 ScheduleProgram(const QString &name, const QString &channel, const QString &begin,
+		const QString &duration, int repeat, const QString &profile);
 	void RemoveProgram(quint32 key);
+	// every word of 'query' has to be the beginning of a word of the event
+	// an empty 'language' searches all languages
+	QList<TelevisionProgramGuideEntryStruct> SearchProgramGuide(const QString &query,
+		const QString &language);
+	// the current and the next event of every channel with epg data
+	QList<TelevisionProgramGuideEntryStruct> ListCurrentPrograms(const QString &language);
 
 private:
 	DvbTab *dvbTab;
@@ -192,4 +202,17 @@ struct TelevisionScheduleEntryStruct
 Q_DECLARE_METATYPE(TelevisionScheduleEntryStruct)
 Q_DECLARE_METATYPE(QList<TelevisionScheduleEntryStruct>)
 
+struct TelevisionProgramGuideEntryStruct
+{
+	QString channel;
+	QString begin;
+	QString duration;
+	QString title;
+	QString subheading;
+	quint32 recordingKey; // 0 if the event isn't scheduled
+};
+
+Q_DECLARE_METATYPE(TelevisionProgramGuideEntryStruct)
+Q_DECLARE_METATYPE(QList<TelevisionProgramGuideEntryStruct>)
+
 #endif /* DBUSOBJECTS_H */
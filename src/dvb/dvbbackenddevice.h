@@ -155,6 +155,7 @@ public:
 	virtual bool tune(const DvbTransponder &transponder) = 0; // discards obsolete data
 	virtual bool getProps(DvbTransponder &transponder) = 0;
 	virtual bool isTuned() = 0;
+	virtual bool hasCarrier() = 0; // something is received (not necessarily a lock)
 	virtual float getSignal(Scale &scale) = 0;
 	virtual float getSnr(Scale &scale) = 0;
 	virtual float getFrqMHz() = 0;
@@ -98,6 +98,22 @@ DvbConfigDialog::DvbConfigDialog(DvbManager *manager_, QWidget *parent) : QDialo
 	connect(toolButton, SIGNAL(clicked()), this, SLOT(changeTimeShiftFolder()));
 	gridLayout->addWidget(toolButton, line++, 2);
 
+	gridLayout->addWidget(new QLabel(i18n("Time shift buffer size (GiB):")), line, 0);
+
+	timeShiftBufferSizeBox = new QSpinBox(widget);
+	timeShiftBufferSizeBox->setRange(0, 999);
+	timeShiftBufferSizeBox->setValue(manager->getTimeShiftBufferSize());
+	timeShiftBufferSizeBox->setToolTip(i18n("Use 0 to keep the time shift buffer in memory only."));
+	gridLayout->addWidget(timeShiftBufferSizeBox, line++, 1);
+
+	gridLayout->addWidget(new QLabel(i18n("Time shift buffer duration (minutes):")), line, 0);
+
+	timeShiftBufferDurationBox = new QSpinBox(widget);
+	timeShiftBufferDurationBox->setRange(0, 9999);
+	timeShiftBufferDurationBox->setValue(manager->getTimeShiftBufferDuration());
+	timeShiftBufferDurationBox->setToolTip(i18n("Use 0 to limit the time shift buffer by its size only."));
+	gridLayout->addWidget(timeShiftBufferDurationBox, line++, 1);
+
 	gridLayout->addWidget(new QLabel(i18n("xmltv file name (optional):")), line, 0);
 
 	xmltvFileNameEdit = new QLineEdit(widget);
@@ -173,15 +189,11 @@ DvbConfigDialog::DvbConfigDialog(DvbManager *manager_, QWidget *parent) : QDialo
 	createInfoFileBox->setChecked(manager->createInfoFile());
 	gridLayout->addWidget(createInfoFileBox, 2, 1);
 
-#if 0
-	// FIXME: this functionality is not working. Comment it out
-
-	gridLayout->addWidget(new QLabel(i18n("Scan channels when idle to fetch fresh EPG data:")),
+	gridLayout->addWidget(new QLabel(i18n("Rescan the channels when the devices are idle:")),
 		3, 0);
 	scanWhenIdleBox = new QCheckBox(widget);
 	scanWhenIdleBox->setChecked(manager->isScanWhenIdle());
 	gridLayout->addWidget(scanWhenIdleBox, 3, 1);
-#endif
 
 	QFrame *frame = new QFrame(widget);
 	frame->setFrameShape(QFrame::HLine);
@@ -564,6 +576,8 @@ void DvbConfigDialog::accept()
 {
 	manager->setRecordingFolder(recordingFolderEdit->text());
 	manager->setTimeShiftFolder(timeShiftFolderEdit->text());
+	manager->setTimeShiftBufferSize(timeShiftBufferSizeBox->value());
+	manager->setTimeShiftBufferDuration(timeShiftBufferDurationBox->value());
 	manager->setXmltvFileName(xmltvFileNameEdit->text());
 	manager->setNamingFormat(namingFormat->text());
 	manager->setActionAfterRecording(actionAfterRecordingLineEdit->text());
@@ -572,9 +586,7 @@ void DvbConfigDialog::accept()
 	manager->setOverride6937Charset(override6937CharsetBox->isChecked());
 	manager->setCreateInfoFile(createInfoFileBox->isChecked());
 	manager->setDisableEpg(disableEpgBox->isChecked());
-#if 0
 	manager->setScanWhenIdle(scanWhenIdleBox->isChecked());
-#endif
 	manager->setRecordingRegexList(QStringList());
 	manager->setRecordingRegexPriorityList(QList<int>());
 
@@ -598,7 +610,6 @@ void DvbConfigDialog::accept()
 	manager->getRecordingModel()->findNewRecordings();
 	manager->getRecordingModel()->removeDuplicates();
 	manager->getRecordingModel()->disableConflicts();
-	//manager->getRecordingModel()->scanChannels();
 	manager->writeDeviceConfigs();
 
 	QDialog::accept();
@@ -101,6 +101,8 @@ private:
 	QTabWidget *tabWidget;
 	QLineEdit *recordingFolderEdit;
 	QLineEdit *timeShiftFolderEdit;
+	QSpinBox *timeShiftBufferSizeBox;
+	QSpinBox *timeShiftBufferDurationBox;
 	QLineEdit *xmltvFileNameEdit;
 	QSpinBox *beginMarginBox;
 	QSpinBox *endMarginBox;
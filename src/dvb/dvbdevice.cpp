@@ -240,7 +240,8 @@ void DvbDataDumper::processData(const char data[188])
 }
 
 DvbDevice::DvbDevice(DvbBackendDevice *backend_, QObject *parent) : QObject(parent),
-	backend(backend_), deviceState(DeviceReleased), dataDumper(NULL), cleanUpFilters(false),
+	backend(backend_), deviceState(DeviceReleased), frontendTimeout(0), carrierCheck(false),
+	carrierTimeout(0), tuningTime(0), dataDumper(NULL), cleanUpFilters(false),
 	isAuto(false), unusedBuffersHead(NULL), usedBuffersHead(NULL), usedBuffersTail(NULL)
 {
 	backend->setFrontendDevice(this);
@@ -292,6 +293,8 @@ void DvbDevice::tune(const DvbTransponder &transponder)
 		if (backend->tune(transponder)) {
 			setDeviceState(DeviceTuning);
 			frontendTimeout = config->timeout;
+			carrierTimeout = getCarrierTimeout();
+			tuningTime = 0;
 			frontendTimer.start(100);
 			discardBuffers();
 		} else {
@@ -386,6 +389,8 @@ void DvbDevice::tune(const DvbTransponder &transponder)
 		if (!moveRotor) {
 			setDeviceState(DeviceTuning);
 			frontendTimeout = config->timeout;
+			carrierTimeout = getCarrierTimeout();
+			tuningTime = 0;
 		} else {
 			setDeviceState(DeviceRotorMoving);
 			frontendTimeout = 15000;
@@ -453,7 +458,7 @@ bool DvbDevice::addPidFilter(int pid, DvbPidFilter *filter)
 	if (it == filters.end()) {
 		it = filters.insert(pid, DvbFilterInternal());
 
-		if (dataDumper != NULL) {
+		if ((dataDumper != NULL) && (pid != 0x2000)) {
 			it->filters.append(dataDumper);
 		}
 	}
@@ -643,8 +648,21 @@ void DvbDevice::reacquire(const DvbConfigBase *config_)
 	setDeviceState(DeviceIdle);
 }
 
+int DvbDevice::getCarrierTimeout() const
+{
+	if (!carrierCheck) {
+		return 0;
+	}
+
+	// some frontends (for example dvb-s2 behind a diseqc switch) report the
+	// carrier late, so the limit is never shorter than 1.5 seconds
+	return qMax(config->timeout / 2, 1500);
+}
+
 void DvbDevice::release()
 {
+	carrierCheck = false;
+	carrierTimeout = 0;
 	setDeviceState(DeviceReleased);
 	stop();
 	backend->release();
@@ -662,7 +680,9 @@ void DvbDevice::enableDvbDump()
 	QMap<int, DvbFilterInternal>::iterator end = filters.end();
 
 	for (; it != end; ++it) {
-		it->filters.append(dataDumper);
+		if (it.key() != 0x2000) {
+			it->filters.append(dataDumper);
+		}
 	}
 
 	backend->enableDvbDump();
@@ -683,6 +703,16 @@ void DvbDevice::frontendEvent()
 	// FIXME progress bar when moving rotor
 
 	frontendTimeout -= 100;
+	tuningTime += 100;
+
+	if ((carrierTimeout > 0) && !isAuto && (deviceState == DeviceTuning) &&
+	    (tuningTime >= carrierTimeout) && (frontendTimeout > 0) && !backend->hasCarrier()) {
+		qCDebug(logDvb, "no carrier on %.2f MHz", backend->getFrqMHz());
+		frontendTimer.stop();
+		autoTransponder.setTransmissionType(DvbTransponderBase::Invalid);
+		setDeviceState(DeviceIdle);
+		return;
+	}
 
 	if (frontendTimeout <= 0) {
 		frontendTimer.stop();
@@ -975,6 +1005,9 @@ void DvbDevice::customEvent(QEvent *)
 			break;
 		}
 
+		// pid 0x2000 means the whole transport stream
+		bool hasFullTsFilter = filters.contains(0x2000);
+
 		for (int i = 0; i < buffer->size; i += 188) {
 			char *packet = (buffer->data + i);
 
@@ -986,6 +1019,19 @@ void DvbDevice::customEvent(QEvent *)
 			int pid = ((static_cast<unsigned char>(packet[1]) << 8) |
 				static_cast<unsigned char>(packet[2])) & ((1 << 13) - 1);
 
+			if (hasFullTsFilter) {
+				QMap<int, DvbFilterInternal>::const_iterator it = filters.constFind(0x2000);
+
+				if (it != filters.constEnd()) {
+					const QList<DvbPidFilter *> &pidFilters = it->filters;
+					int pidFiltersSize = pidFilters.size();
+
+					for (int j = 0; j < pidFiltersSize; ++j) {
+						pidFilters.at(j)->processData(packet);
+					}
+				}
+			}
+
 			QMap<int, DvbFilterInternal>::const_iterator it = filters.constFind(pid);
 
 			if (it == filters.constEnd()) {
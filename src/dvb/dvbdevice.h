@@ -103,6 +103,13 @@ public:
 	float getSnr(DvbBackendDevice::Scale &scale) const;
 	DvbTransponder getAutoTransponder() const;
 
+	// tuning is given up early if there's no carrier at all (used by scans to skip
+	// dead transponders); the limit is derived from the tuning timeout of the config
+	void setCarrierCheck(bool carrierCheck_)
+	{
+		carrierCheck = carrierCheck_;
+	}
+
 	/*
 	 * management functions (must be only called by DvbManager)
 	 */
@@ -120,6 +127,7 @@ private slots:
 
 private:
 	void setDeviceState(DeviceState newState);
+	int getCarrierTimeout() const; // ms, 0 = no carrier check
 	void discardBuffers();
 	void stop();
 
@@ -133,6 +141,9 @@ private:
 	QExplicitlySharedDataPointer<const DvbConfigBase> config;
 
 	int frontendTimeout;
+	bool carrierCheck;
+	int carrierTimeout; // ms, 0 = wait for the tuning timeout
+	int tuningTime; // ms
 	QTimer frontendTimer;
 	QMap<int, DvbFilterInternal> filters;
 	QMap<int, DvbSectionFilterInternal> sectionFilters;
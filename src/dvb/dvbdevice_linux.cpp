@@ -48,7 +48,7 @@ extern "C" {
 // krazy:excludeall=syscalls
 
 DvbLinuxDevice::DvbLinuxDevice(QObject *parent) : QThread(parent), ready(false), frontend(NULL),
-	enabled(false), dvrFd(-1), dvrBuffer(NULL, 0), cam(parent)
+	enabled(false), carrierErrorReported(false), dvrFd(-1), dvrBuffer(NULL, 0), cam(parent)
 {
 	verbose = 1;
 	numDemux = 0;
@@ -1296,6 +1296,29 @@ bool DvbLinuxDevice::isTuned()
 	return ((status & FE_HAS_LOCK) != 0);
 }
 
+bool DvbLinuxDevice::hasCarrier()
+{
+	Q_ASSERT(dvbv5_parms);
+	uint32_t status = 0;
+
+	if ((dvb_fe_get_stats(dvbv5_parms) != 0) ||
+	    (dvb_fe_retrieve_stats(dvbv5_parms, DTV_STATUS, &status) != 0)) {
+		// the status is polled every 100 ms while tuning
+		if (!carrierErrorReported) {
+			qCWarning(logDev, "ioctl FE_READ_STATUS failed for frontend %s",
+				qPrintable(frontendPath));
+			carrierErrorReported = true;
+		}
+
+		// don't give up the transponder because of that
+		return true;
+	}
+
+	carrierErrorReported = false;
+	return ((status & (FE_HAS_SIGNAL | FE_HAS_CARRIER | FE_HAS_VITERBI | FE_HAS_SYNC |
+		FE_HAS_LOCK)) != 0);
+}
+
 float DvbLinuxDevice::getSignal(Scale &scale)
 {
 	Q_ASSERT(dvbv5_parms);
@@ -73,6 +73,7 @@ protected:
 	bool tune(const DvbTransponder &transponder) override; // discards obsolete data
 	bool getProps(DvbTransponder &transponder) override;
 	bool isTuned() override;
+	bool hasCarrier() override;
 	float getFrqMHz() override;
 	float getSignal(Scale &scale) override;
 	float getSnr(DvbBackendDevice::Scale &scale) override;
@@ -94,6 +95,7 @@ private:
 	Capabilities capabilities;
 	DvbFrontendDevice *frontend;
 	bool enabled;
+	bool carrierErrorReported; // hasCarrier() only warns once
 	QMap<int, int> dmxFds;
 
 	float freqMHz;
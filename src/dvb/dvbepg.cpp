@@ -55,6 +55,180 @@ bool DvbEpgEntryId::operator<(const DvbEpgEntryId &other) const
 	return false;
 }
 
+QStringList DvbEpgTextIndex::tokenize(const QString &text)
+{
+	QStringList words;
+	QString foldedText = text.toCaseFolded();
+	int begin = -1;
+
+	for (int i = 0; i <= foldedText.size(); ++i) {
+		if ((i < foldedText.size()) && foldedText.at(i).isLetterOrNumber()) {
+			if (begin < 0) {
+				begin = i;
+			}
+		} else if (begin >= 0) {
+			words.append(foldedText.mid(begin, i - begin));
+			begin = -1;
+		}
+	}
+
+	return words;
+}
+
+QSet<QString> DvbEpgTextIndex::entryWords(const DvbEpgLangEntry &langEntry)
+{
+	QSet<QString> words;
+
+	foreach (const QString &word, tokenize(langEntry.title)) {
+		words.insert(word);
+	}
+
+	foreach (const QString &word, tokenize(langEntry.subheading)) {
+		words.insert(word);
+	}
+
+	foreach (const QString &word, tokenize(langEntry.details)) {
+		words.insert(word);
+	}
+
+	return words;
+}
+
+bool DvbEpgTextIndex::matches(const DvbEpgEntry &entry, const QStringList &words,
+	const QString &lang)
+{
+	QSet<QString> entryWordSet;
+
+	for (QHash<QString, DvbEpgLangEntry>::ConstIterator it = entry.langEntry.constBegin();
+	     it != entry.langEntry.constEnd(); ++it) {
+		if (lang.isEmpty() || (it.key() == lang) || (it.key() == FIRST_LANG)) {
+			entryWordSet.unite(entryWords(*it));
+		}
+	}
+
+	foreach (const QString &word, words) {
+		bool found = false;
+
+		foreach (const QString &entryWord, entryWordSet) {
+			if (entryWord.startsWith(word)) {
+				found = true;
+				break;
+			}
+		}
+
+		if (!found) {
+			return false;
+		}
+	}
+
+	return !words.isEmpty();
+}
+
+void DvbEpgTextIndex::insert(const DvbSharedEpgEntry &entry)
+{
+	for (QHash<QString, DvbEpgLangEntry>::ConstIterator it = entry->langEntry.constBegin();
+	     it != entry->langEntry.constEnd(); ++it) {
+		WordMap &wordMap = langWords[it.key()];
+
+		foreach (const QString &word, entryWords(*it)) {
+			wordMap[word].insert(entry);
+		}
+	}
+}
+
+void DvbEpgTextIndex::remove(const DvbSharedEpgEntry &entry)
+{
+	for (QHash<QString, DvbEpgLangEntry>::ConstIterator it = entry->langEntry.constBegin();
+	     it != entry->langEntry.constEnd(); ++it) {
+		QHash<QString, WordMap>::Iterator langIt = langWords.find(it.key());
+
+		if (langIt == langWords.end()) {
+			continue;
+		}
+
+		foreach (const QString &word, entryWords(*it)) {
+			WordMap::Iterator wordIt = langIt->find(word);
+
+			if (wordIt != langIt->end()) {
+				wordIt->remove(entry);
+
+				if (wordIt->isEmpty()) {
+					langIt->erase(wordIt);
+				}
+			}
+		}
+
+		if (langIt->isEmpty()) {
+			langWords.erase(langIt);
+		}
+	}
+}
+
+QSet<DvbSharedEpgEntry> DvbEpgTextIndex::findPrefix(const QString &word,
+	const QString &lang) const
+{
+	QSet<DvbSharedEpgEntry> result;
+
+	for (QHash<QString, WordMap>::ConstIterator langIt = langWords.constBegin();
+	     langIt != langWords.constEnd(); ++langIt) {
+		if (!lang.isEmpty() && (langIt.key() != lang) &&
+		    (langIt.key() != FIRST_LANG)) {
+			continue;
+		}
+
+		// the words are sorted, so all words with this prefix follow each other
+		for (WordMap::ConstIterator it = langIt->lowerBound(word);
+		     (it != langIt->constEnd()) && it.key().startsWith(word); ++it) {
+			result.unite(*it);
+		}
+	}
+
+	return result;
+}
+
+QList<DvbSharedEpgEntry> DvbEpgTextIndex::findContaining(const QString &part,
+	const QString &lang) const
+{
+	QSet<DvbSharedEpgEntry> result;
+
+	for (QHash<QString, WordMap>::ConstIterator langIt = langWords.constBegin();
+	     langIt != langWords.constEnd(); ++langIt) {
+		if (!lang.isEmpty() && (langIt.key() != lang) &&
+		    (langIt.key() != FIRST_LANG)) {
+			continue;
+		}
+
+		// only the (distinct) words are visited, not the entries
+		for (WordMap::ConstIterator it = langIt->constBegin(); it != langIt->constEnd(); ++it) {
+			if (it.key().contains(part)) {
+				result.unite(*it);
+			}
+		}
+	}
+
+	return result.toList();
+}
+
+QList<DvbSharedEpgEntry> DvbEpgTextIndex::find(const QStringList &words,
+	const QString &lang) const
+{
+	QSet<DvbSharedEpgEntry> result;
+
+	for (int i = 0; i < words.size(); ++i) {
+		if (i == 0) {
+			result = findPrefix(words.at(i), lang);
+		} else {
+			result.intersect(findPrefix(words.at(i), lang));
+		}
+
+		if (result.isEmpty()) {
+			break;
+		}
+	}
+
+	return result.toList();
+}
+
 DvbEpgModel::DvbEpgModel(DvbManager *manager_, QObject *parent) : QObject(parent),
 	manager(manager_), hasPendingOperation(false)
 {
@@ -71,6 +245,14 @@ DvbEpgModel::DvbEpgModel(DvbManager *manager_, QObject *parent) : QObject(parent
 	connect(manager->getRecordingModel(), SIGNAL(recordingRemoved(DvbSharedRecording)),
 		this, SLOT(recordingRemoved(DvbSharedRecording)));
 
+	// new and updated entries are matched against the recording regexes
+	connect(this, SIGNAL(entryAdded(DvbSharedEpgEntry)),
+		manager->getRecordingModel(), SLOT(epgEntryChanged(DvbSharedEpgEntry)));
+	connect(this, SIGNAL(entryUpdated(DvbSharedEpgEntry)),
+		manager->getRecordingModel(), SLOT(epgEntryChanged(DvbSharedEpgEntry)));
+	connect(this, SIGNAL(entryRemoved(DvbSharedEpgEntry)),
+		manager->getRecordingModel(), SLOT(epgEntryRemoved(DvbSharedEpgEntry)));
+
 	// TODO use SQL to store epg data
 
 	QFile file(QStandardPaths::writableLocation(QStandardPaths::DataLocation) + QLatin1String("/epgdata.dvb"));
@@ -235,11 +417,6 @@ void DvbEpgModel::setRecordings(const QMap<DvbSharedRecording, DvbSharedEpgEntry
 	recordings = map;
 }
 
-QMap<DvbEpgEntryId, DvbSharedEpgEntry> DvbEpgModel::getEntries() const
-{
-	return entries;
-}
-
 QHash<DvbSharedChannel, int> DvbEpgModel::getEpgChannels() const
 {
 	return epgChannels;
@@ -248,9 +425,8 @@ QHash<DvbSharedChannel, int> DvbEpgModel::getEpgChannels() const
 QList<DvbSharedEpgEntry> DvbEpgModel::getCurrentNext(const DvbSharedChannel &channel) const
 {
 	QList<DvbSharedEpgEntry> result;
-	DvbEpgEntry fakeEntry(channel);
 
-	for (ConstIterator it = entries.lowerBound(DvbEpgEntryId(&fakeEntry));
+	for (ConstIterator it = findFirstEntry(channel, QDateTime::currentDateTime().toUTC());
 	     it != entries.constEnd(); ++it) {
 		const DvbSharedEpgEntry &entry = *it;
 
@@ -268,6 +444,84 @@ QList<DvbSharedEpgEntry> DvbEpgModel::getCurrentNext(const DvbSharedChannel &cha
 	return result;
 }
 
+QHash<DvbSharedChannel, QList<DvbSharedEpgEntry> > DvbEpgModel::getCurrentNext() const
+{
+	QHash<DvbSharedChannel, QList<DvbSharedEpgEntry> > result;
+	QDateTime currentDateTime = QDateTime::currentDateTime().toUTC();
+
+	for (QHash<DvbSharedChannel, int>::ConstIterator channelIt = epgChannels.constBegin();
+	     channelIt != epgChannels.constEnd(); ++channelIt) {
+		const DvbSharedChannel &channel = channelIt.key();
+		QList<DvbSharedEpgEntry> &currentNext = result[channel];
+
+		for (ConstIterator it = findFirstEntry(channel, currentDateTime);
+		     (it != entries.constEnd()) && ((*it)->channel == channel); ++it) {
+			currentNext.append(*it);
+
+			if (currentNext.size() == 2) {
+				break;
+			}
+		}
+	}
+
+	return result;
+}
+
+DvbEpgEntryRange DvbEpgModel::getChannelEntries(const DvbSharedChannel &channel,
+	const QDateTime &begin, const QDateTime &end) const
+{
+	ConstIterator beginIt = findFirstEntry(channel, begin);
+	ConstIterator endIt = beginIt;
+
+	if (end.isValid()) {
+		if (!begin.isValid() || (begin < end)) {
+			DvbEpgEntry fakeEntry(channel);
+			fakeEntry.begin = end;
+			endIt = entries.lowerBound(DvbEpgEntryId(&fakeEntry));
+		}
+	} else {
+		while ((endIt != entries.constEnd()) && ((*endIt)->channel == channel)) {
+			++endIt;
+		}
+	}
+
+	return DvbEpgEntryRange(beginIt, endIt);
+}
+
+DvbEpgModel::ConstIterator DvbEpgModel::findFirstEntry(const DvbSharedChannel &channel,
+	const QDateTime &begin) const
+{
+	DvbEpgEntry fakeEntry(channel);
+	fakeEntry.begin = begin;
+	ConstIterator it = entries.lowerBound(DvbEpgEntryId(&fakeEntry));
+
+	if (begin.isValid() && (it != entries.constBegin())) {
+		// the previous entry may still be running at 'begin'
+		ConstIterator previousIt = it;
+		--previousIt;
+		const DvbSharedEpgEntry &entry = *previousIt;
+
+		if ((entry->channel == channel) &&
+		    (entry->begin.addSecs(QTime(0, 0, 0).secsTo(entry->duration)) > begin)) {
+			it = previousIt;
+		}
+	}
+
+	return it;
+}
+
+QList<DvbSharedEpgEntry> DvbEpgModel::findEntries(const QStringList &words,
+	const QString &lang) const
+{
+	return textIndex.find(words, lang);
+}
+
+QList<DvbSharedEpgEntry> DvbEpgModel::findEntriesContaining(const QString &part,
+	const QString &lang) const
+{
+	return textIndex.findContaining(part, lang);
+}
+
 void DvbEpgModel::Debug(QString text, const DvbSharedEpgEntry &entry)
 {
 	if (!QLoggingCategory::defaultCategory()->isEnabled(QtDebugMsg))
@@ -325,6 +579,7 @@ DvbSharedEpgEntry DvbEpgModel::addEntry(const DvbEpgEntry &entry)
 		// New event data for the same event
 		if (existingEntry->details(FIRST_LANG).isEmpty() && !entry.details(FIRST_LANG).isEmpty()) {
 			emit entryAboutToBeUpdated(existingEntry);
+			textIndex.remove(existingEntry);
 
 			QHashIterator<QString, DvbEpgLangEntry> i(entry.langEntry);
 
@@ -335,6 +590,7 @@ DvbSharedEpgEntry DvbEpgModel::addEntry(const DvbEpgEntry &entry)
 
 				const_cast<DvbEpgEntry *>(existingEntry.constData())->langEntry[i.key()].details = langEntry.details;
 			}
+			textIndex.insert(existingEntry);
 			emit entryUpdated(existingEntry);
 			Debug("updated", existingEntry);
 		}
@@ -348,6 +604,7 @@ DvbSharedEpgEntry DvbEpgModel::addEntry(const DvbEpgEntry &entry)
 			if (existingEntry->details(FIRST_LANG).isEmpty() && !entry.details(FIRST_LANG).isEmpty()) {
 				// needed for atsc
 				emit entryAboutToBeUpdated(existingEntry);
+				textIndex.remove(existingEntry);
 
 				QHashIterator<QString, DvbEpgLangEntry> i(entry.langEntry);
 
@@ -358,6 +615,7 @@ DvbSharedEpgEntry DvbEpgModel::addEntry(const DvbEpgEntry &entry)
 
 					const_cast<DvbEpgEntry *>(existingEntry.constData())->langEntry[i.key()].details = langEntry.details;
 				}
+				textIndex.insert(existingEntry);
 				emit entryUpdated(existingEntry);
 				Debug("updated2", existingEntry);
 			}
@@ -367,6 +625,7 @@ DvbSharedEpgEntry DvbEpgModel::addEntry(const DvbEpgEntry &entry)
 
 		DvbSharedEpgEntry newEntry(new DvbEpgEntry(entry));
 		entries.insert(DvbEpgEntryId(newEntry), newEntry);
+		textIndex.insert(newEntry);
 
 		if (newEntry->recording.isValid()) {
 			recordings.insert(newEntry->recording, newEntry);
@@ -592,6 +851,7 @@ DvbEpgModel::Iterator DvbEpgModel::removeEntry(Iterator it)
 		emit epgChannelRemoved(entry->channel);
 	}
 
+	textIndex.remove(entry);
 	emit entryRemoved(entry);
 	return entries.erase(it);
 }
@@ -1100,6 +1360,13 @@ void DvbEpgFilter::processSection(const char *data, int size)
 		}
 
 		epgModel->addEntry(epgEntry);
+
+		if ((epgEntry.type == DvbEpgEntry::EitActualTsPresentFollowing) ||
+		    (epgEntry.type == DvbEpgEntry::EitOtherTsPresentFollowing)) {
+			// section 0 contains the present event, section 1 the following event
+			manager->getRecordingModel()->updateRunningStatus(channel, entry.eventId(),
+				epgEntry.begin, entry.runningStatus(), (eitSection.sectionNumber() == 0));
+		}
 	}
 }
 
@@ -21,6 +21,8 @@
 #ifndef DVBEPG_H
 #define DVBEPG_H
 
+#include <QSet>
+#include <QStringList>
 #include "dvbrecording.h"
 
 class AtscEpgFilter;
@@ -238,9 +240,6 @@ public:
 	}
 };
 
-typedef ExplicitlySharedDataPointer<const DvbEpgEntry> DvbSharedEpgEntry;
-Q_DECLARE_TYPEINFO(DvbSharedEpgEntry, Q_MOVABLE_TYPE);
-
 class DvbEpgEntryId
 {
 public:
@@ -257,6 +256,84 @@ private:
 	const DvbEpgEntry *entry;
 };
 
+// view on a part of the entries of DvbEpgModel (sorted by channel and begin)
+// it is only valid until the next modification of the epg model
+
+class DvbEpgEntryRange
+{
+public:
+	typedef QMap<DvbEpgEntryId, DvbSharedEpgEntry>::ConstIterator ConstIterator;
+	typedef ConstIterator const_iterator;
+
+	DvbEpgEntryRange(ConstIterator begin_, ConstIterator end_) : beginIt(begin_),
+		endIt(end_) { }
+	~DvbEpgEntryRange() { }
+
+	bool isEmpty() const
+	{
+		return (beginIt == endIt);
+	}
+
+	ConstIterator begin() const
+	{
+		return beginIt;
+	}
+
+	ConstIterator end() const
+	{
+		return endIt;
+	}
+
+	ConstIterator constBegin() const
+	{
+		return beginIt;
+	}
+
+	ConstIterator constEnd() const
+	{
+		return endIt;
+	}
+
+private:
+	ConstIterator beginIt;
+	ConstIterator endIt;
+};
+
+// inverted index over the words of title, subheading and details (per language)
+
+class DvbEpgTextIndex
+{
+public:
+	DvbEpgTextIndex() { }
+	~DvbEpgTextIndex() { }
+
+	// splits the text into case folded words
+	static QStringList tokenize(const QString &text);
+
+	// every word has to be a prefix of a word of the entry
+	// an empty 'lang' means that all languages are searched; text without
+	// a language code (FIRST_LANG) is searched for every language
+	static bool matches(const DvbEpgEntry &entry, const QStringList &words,
+		const QString &lang = QString());
+
+	void insert(const DvbSharedEpgEntry &entry);
+	// must be called before the text of the entry is modified
+	void remove(const DvbSharedEpgEntry &entry);
+	QList<DvbSharedEpgEntry> find(const QStringList &words,
+		const QString &lang = QString()) const;
+	// 'part' (case folded) may appear anywhere inside a word of the entry
+	QList<DvbSharedEpgEntry> findContaining(const QString &part,
+		const QString &lang = QString()) const;
+
+private:
+	typedef QMap<QString, QSet<DvbSharedEpgEntry> > WordMap;
+
+	static QSet<QString> entryWords(const DvbEpgLangEntry &langEntry);
+	QSet<DvbSharedEpgEntry> findPrefix(const QString &word, const QString &lang) const;
+
+	QHash<QString, WordMap> langWords;
+};
+
 class DvbEpgModel : public QObject
 {
 	Q_OBJECT
@@ -266,11 +343,21 @@ public:
 	DvbEpgModel(DvbManager *manager_, QObject *parent);
 	~DvbEpgModel();
 
-	QMap<DvbEpgEntryId, DvbSharedEpgEntry> getEntries() const;
 	QMap<DvbSharedRecording, DvbSharedEpgEntry> getRecordings() const;
 	void setRecordings(const QMap<DvbSharedRecording, DvbSharedEpgEntry> map);
 	QHash<DvbSharedChannel, int> getEpgChannels() const;
 	QList<DvbSharedEpgEntry> getCurrentNext(const DvbSharedChannel &channel) const;
+	// current and next entry for all channels with epg data
+	QHash<DvbSharedChannel, QList<DvbSharedEpgEntry> > getCurrentNext() const;
+	// entries of 'channel' which overlap [begin, end) (times in UTC)
+	// an invalid 'begin' or 'end' means that the range is unbounded on that side
+	DvbEpgEntryRange getChannelEntries(const DvbSharedChannel &channel,
+		const QDateTime &begin = QDateTime(), const QDateTime &end = QDateTime()) const;
+	// see DvbEpgTextIndex::find()
+	QList<DvbSharedEpgEntry> findEntries(const QStringList &words,
+		const QString &lang = QString()) const;
+	QList<DvbSharedEpgEntry> findEntriesContaining(const QString &part,
+		const QString &lang = QString()) const;
 
 	DvbSharedEpgEntry addEntry(const DvbEpgEntry &entry);
 	void scheduleProgram(const DvbSharedEpgEntry &entry, int extraSecondsBefore,
@@ -298,12 +385,16 @@ private slots:
 private:
 	void timerEvent(QTimerEvent *event) override;
 	void Debug(QString text, const DvbSharedEpgEntry &entry);
+	// first entry of 'channel' which ends after 'begin'
+	ConstIterator findFirstEntry(const DvbSharedChannel &channel,
+		const QDateTime &begin) const;
 
 	Iterator removeEntry(Iterator it);
 
 	DvbManager *manager;
 	QDateTime currentDateTimeUtc;
 	QMap<DvbEpgEntryId, DvbSharedEpgEntry> entries;
+	DvbEpgTextIndex textIndex;
 	QMap<DvbSharedRecording, DvbSharedEpgEntry> recordings;
 	QHash<DvbSharedChannel, int> epgChannels;
 	QList<QExplicitlySharedDataPointer<DvbEpgFilter> > dvbEpgFilters;
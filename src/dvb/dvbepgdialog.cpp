@@ -132,6 +132,9 @@ DvbEpgDialog::DvbEpgDialog(DvbManager *manager_, QWidget *parent) : QDialog(pare
 	connect(epgTableModel, SIGNAL(layoutChanged()), this, SLOT(checkEntry()));
 	QLineEdit *lineEdit = new QLineEdit(widget);
 	lineEdit->setClearButtonEnabled(true);
+	// the search is answered by the epg text index, which only knows the beginnings of words
+	lineEdit->setToolTip(i18n("Shows the events which contain words beginning with every "
+		"word you type, in the selected language."));
 	connect(lineEdit, SIGNAL(textChanged(QString)),
 		epgTableModel, SLOT(setContentFilter(QString)));
 	boxLayout->addWidget(lineEdit);
@@ -388,9 +391,9 @@ bool DvbEpgTableModelHelper::filterAcceptsItem(const DvbSharedEpgEntry &entry) c
 	case ChannelFilter:
 		return (entry->channel == channelFilter);
 	case ContentFilter:
-		return ((contentFilter.indexIn(entry->title(FIRST_LANG)) >= 0) ||
-			(contentFilter.indexIn(entry->subheading(FIRST_LANG)) >= 0) ||
-			(contentFilter.indexIn(entry->details(FIRST_LANG)) >= 0));
+		// only added or updated entries are tokenized
+		return (contentFilterMatched ||
+			DvbEpgTextIndex::matches(*entry, contentFilter, contentFilterLang));
 	}
 
 	return false;
@@ -399,7 +402,6 @@ bool DvbEpgTableModelHelper::filterAcceptsItem(const DvbSharedEpgEntry &entry) c
 DvbEpgTableModel::DvbEpgTableModel(QObject *parent) : TableModel<DvbEpgTableModelHelper>(parent),
 	epgModel(NULL), contentFilterEventPending(false)
 {
-	helper.contentFilter.setCaseSensitivity(Qt::CaseInsensitive);
 }
 
 DvbEpgTableModel::~DvbEpgTableModel()
@@ -427,15 +429,24 @@ void DvbEpgTableModel::setEpgModel(DvbEpgModel *epgModel_)
 void DvbEpgTableModel::setChannelFilter(const DvbSharedChannel &channel)
 {
 	helper.channelFilter = channel;
-	helper.contentFilter.setPattern(QString());
+	helper.contentFilter.clear();
 	helper.filterType = DvbEpgTableModelHelper::ChannelFilter;
-	reset(epgModel->getEntries());
+	reset(epgModel->getChannelEntries(channel));
 }
 
 void DvbEpgTableModel::setLanguage(QString lang)
 {
 	currentLanguage = lang;
-	reset(epgModel->getEntries());
+	helper.contentFilterLang = lang;
+
+	switch (helper.filterType) {
+	case DvbEpgTableModelHelper::ChannelFilter:
+		reset(epgModel->getChannelEntries(helper.channelFilter));
+		break;
+	case DvbEpgTableModelHelper::ContentFilter:
+		resetContentFilter();
+		break;
+	}
 }
 
 QVariant DvbEpgTableModel::data(const QModelIndex &index, int role) const
@@ -490,9 +501,9 @@ QVariant DvbEpgTableModel::headerData(int section, Qt::Orientation orientation,
 void DvbEpgTableModel::setContentFilter(const QString &pattern)
 {
 	helper.channelFilter = DvbSharedChannel();
-	helper.contentFilter.setPattern(pattern);
+	helper.contentFilter = DvbEpgTextIndex::tokenize(pattern);
 
-	if (!pattern.isEmpty()) {
+	if (!helper.contentFilter.isEmpty()) {
 		helper.filterType = DvbEpgTableModelHelper::ContentFilter;
 
 		if (!contentFilterEventPending) {
@@ -533,6 +544,13 @@ void DvbEpgTableModel::customEvent(QEvent *event)
 	contentFilterEventPending = false;
 
 	if (helper.filterType == DvbEpgTableModelHelper::ContentFilter) {
-		reset(epgModel->getEntries());
+		resetContentFilter();
 	}
 }
+
+void DvbEpgTableModel::resetContentFilter()
+{
+	helper.contentFilterMatched = true;
+	reset(epgModel->findEntries(helper.contentFilter, helper.contentFilterLang));
+	helper.contentFilterMatched = false;
+}
@@ -93,7 +93,7 @@ private slots:
 class DvbEpgTableModelHelper
 {
 public:
-	DvbEpgTableModelHelper() : filterType(ChannelFilter) { }
+	DvbEpgTableModelHelper() : filterType(ChannelFilter), contentFilterMatched(false) { }
 	~DvbEpgTableModelHelper() { }
 
 	typedef DvbSharedEpgEntry ItemType;
@@ -112,8 +112,12 @@ public:
 	bool filterAcceptsItem(const DvbSharedEpgEntry &epgEntry) const;
 
 	DvbSharedChannel channelFilter;
-	QStringMatcher contentFilter;
+	QStringList contentFilter; // see DvbEpgTextIndex::tokenize()
+	// each word has to begin a word of the event in this language (empty = any language)
+	QString contentFilterLang;
 	FilterType filterType;
+	// the items are found by the text index (they don't have to be matched again)
+	bool contentFilterMatched;
 
 private:
 	Q_DISABLE_COPY(DvbEpgTableModelHelper)
@@ -144,6 +148,7 @@ private slots:
 
 private:
 	void customEvent(QEvent *event) override;
+	void resetContentFilter();
 
 	DvbEpgModel *epgModel;
 	bool contentFilterEventPending;
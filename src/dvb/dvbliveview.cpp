@@ -23,14 +23,17 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <KMessageBox>
+#include <QCoreApplication>
 #include <QDir>
 #include <QLocale>
 #include <QPainter>
 #include <QSet>
 #include <QSocketNotifier>
 #include <QStandardPaths>
+#include <string.h>
 #include <sys/stat.h>  // bsd compatibility
 #include <sys/types.h>  // bsd compatibility
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "dvbdevice.h"
@@ -38,6 +41,9 @@
 #include "dvbliveview_p.h"
 #include "dvbmanager.h"
 
+// bounded queue for the data which doesn't fit into the pipe (~ 4 MiB)
+static const int pipeQueueSize = (256 * 87 * 188);
+
 #if EAGAIN == EWOULDBLOCK
   #define IS_EAGAIN(e) (e == EAGAIN)
 #else
@@ -152,17 +158,15 @@ QPixmap DvbOsd::paintOsd(QRect &rect, const QFont &font, Qt::LayoutDirection)
 
 DvbLiveView::DvbLiveView(DvbManager *manager_, QObject *parent) :
 	QObject(parent), manager(manager_), device(NULL), videoPid(-1),
-	audioPid(-1), subtitlePid(-1), pausedTime(0)
+	audioPid(-1), subtitlePid(-1), pausedTime(0), zapping(false)
 {
 	mediaWidget = manager->getMediaWidget();
 	osdWidget = mediaWidget->getOsdWidget();
 
-	internal = new DvbLiveViewInternal(this);
-	internal->mediaWidget = mediaWidget;
+	internal = new DvbLiveViewInternal(mediaWidget, this);
 
 	connect(&internal->pmtFilter, SIGNAL(pmtSectionChanged(QByteArray)),
 		this, SLOT(pmtSectionChanged(QByteArray)));
-	connect(&patPmtTimer, SIGNAL(timeout()), this, SLOT(insertPatPmt()));
 	connect(&osdTimer, SIGNAL(timeout()), this, SLOT(osdTimeout()));
 
 	connect(internal, SIGNAL(currentAudioStreamChanged(int)),
@@ -206,21 +210,43 @@ void DvbLiveView::replay()
 	}
 
 	internal->channelName = channel->name;
+
+	if (internal->useStream) {
+		internal->stream.setLimits(manager->getTimeShiftFolder(),
+			qint64(manager->getTimeShiftBufferSize()) << 30,
+			manager->getTimeShiftBufferDuration() * 60000);
+	}
+
 	internal->resetPipe();
 	mediaWidget->play(internal);
 
 	internal->pmtFilter.setProgramNumber(channel->serviceId);
 	startDevice();
 
+	recentChannels.removeAll(channel);
+	recentChannels.prepend(channel);
+
+	if (recentChannels.size() > 4) {
+		recentChannels.removeLast();
+	}
+
+	updatePreTuning();
+
 	internal->patGenerator.initPat(channel->transportStreamId, channel->serviceId,
 		channel->pmtPid);
 	videoPid = -1;
 	audioPid = channel->audioPid;
 	subtitlePid = -1;
 	pmtSectionChanged(channel->pmtSectionData);
-	patPmtTimer.start(500);
 
 	internal->buffer.reserve(87 * 188);
+
+	if (!zapData.isEmpty()) {
+		// start with the last random access point instead of waiting for the next one
+		internal->prebuffer(zapData);
+		zapData.clear();
+	}
+
 	QTimer::singleShot(2000, this, SLOT(showOsd()));
 }
 
@@ -242,16 +268,35 @@ DvbDevice *DvbLiveView::getDevice() const
 void DvbLiveView::playChannel(const DvbSharedChannel &channel_)
 {
 	DvbDevice *newDevice = NULL;
+	zapData.clear();
+
+	if (channel.constData() != NULL) {
+		// same transponder, a pre-tuned or another idle device (while the
+		// current device is still in use)
+		newDevice = manager->requestDevice(channel_->source, channel_->transponder,
+			DvbManager::Shared);
+	}
 
 	if ((channel.constData() != NULL) && (channel->source == channel_->source) &&
 	    (channel->transponder.corresponds(channel_->transponder))) {
-		newDevice = manager->requestDevice(channel->source, channel->transponder,
-			DvbManager::Shared);
+		// the zap buffers are removed together with the other filters
+		foreach (DvbZapBuffer *zapBuffer, zapBuffers) {
+			if (zapBuffer->channel == channel_) {
+				zapData = zapBuffer->takeData();
+				break;
+			}
+		}
 	}
 
+	zapping = true;
 	playbackStatusChanged(MediaWidget::Idle);
-	// 1 second delay to release dvb tuner from previous playback
-	usleep(1000000);
+	zapping = false;
+
+	if (newDevice == NULL) {
+		// 1 second delay to release dvb tuner from previous playback
+		usleep(1000000);
+	}
+
 	channel = channel_;
 	device = newDevice;
 
@@ -268,7 +313,7 @@ void DvbLiveView::toggleOsd()
 	case DvbOsd::Off:
 		internal->dvbOsd.init(manager, DvbOsd::ShortOsd,
 			QString(QLatin1String("%1 - %2")).arg(channel->number).arg(channel->name),
-			manager->getEpgModel()->getCurrentNext(channel));
+			manager->getEpgModel()->getCurrentNext().value(channel));
 		osdWidget->showObject(&internal->dvbOsd, 2500);
 		osdTimer.start(2500);
 		break;
@@ -359,12 +404,6 @@ void DvbLiveView::pmtSectionChanged(const QByteArray &pmtSectionData)
 	mediaWidget->subtitlesChanged();
 }
 
-void DvbLiveView::insertPatPmt()
-{
-	internal->buffer.append(internal->patGenerator.generatePackets());
-	internal->buffer.append(internal->pmtGenerator.generatePackets());
-}
-
 void DvbLiveView::deviceStateChanged()
 {
 	switch (device->getDeviceState()) {
@@ -422,15 +461,26 @@ void DvbLiveView::playbackStatusChanged(MediaWidget::PlaybackStatus playbackStat
 		}
 
 		pids.clear();
-		patPmtTimer.stop();
 		osdTimer.stop();
 
+		if (!zapping) {
+			// give up the pre-tuned devices
+			manager->preTune(QList<QPair<QString, DvbTransponder> >());
+		}
+
 		internal->pmtSectionData.clear();
 		internal->patGenerator = DvbSectionGenerator();
 		internal->pmtGenerator = DvbSectionGenerator();
+		internal->patPmtRepetition.reset();
 		internal->buffer.clear();
+		internal->stream.reset();
+
+		if (!zapping) {
+			internal->stream.stopDiskRing();
+		}
+
 		internal->timeShiftFile.close();
-		internal->retryCounter = 0;
+		internal->seekIndex.close();
 		internal->updateUrl();
 		internal->dvbOsd.init(manager, DvbOsd::Off, QString(), QList<DvbSharedEpgEntry>());
 		osdWidget->hideObject();
@@ -439,14 +489,18 @@ void DvbLiveView::playbackStatusChanged(MediaWidget::PlaybackStatus playbackStat
 		if (internal->timeShiftFile.isOpen()) {
 			// FIXME
 			mediaWidget->play(internal);
-			mediaWidget->setPosition(pausedTime);
+			mediaWidget->setPosition(qMax(pausedTime - int(internal->timeShiftStartTime), 0));
 		}
 
 		break;
 	case MediaWidget::Paused:
-		pausedTime = mediaWidget->getPosition() - 10;
-		if (pausedTime < 0)
-			pausedTime = 0;
+		if (internal->useStream) {
+			// the stream keeps the data while the backend is paused
+			break;
+		}
+
+		// the position of the pipe follows the pcr based time line
+		pausedTime = mediaWidget->getPosition();
 		if (internal->timeShiftFile.isOpen()) {
 			break;
 		}
@@ -470,6 +524,9 @@ void DvbLiveView::playbackStatusChanged(MediaWidget::PlaybackStatus playbackStat
 			}
 		}
 
+		internal->seekIndex.open(
+			SeekIndexWriter::indexFileName(internal->timeShiftFile.fileName()));
+		internal->timeShiftStartTime = qMax<qint64>(internal->liveClock.time(), 0);
 		updatePids();
 
 		// Use either the timeshift or the standard file URL
@@ -512,10 +569,12 @@ void DvbLiveView::startDevice()
 	}
 
 	manager->getEpgModel()->startEventFilter(device, channel);
+	startZapBuffers();
 }
 
 void DvbLiveView::stopDevice()
 {
+	stopZapBuffers();
 	manager->getEpgModel()->stopEventFilter(device, channel);
 
 	if (channel->isScrambled && !internal->pmtSectionData.isEmpty()) {
@@ -587,20 +646,608 @@ void DvbLiveView::updatePids(bool forcePatPmtUpdate)
 
 	if (updatePatPmt) {
 		internal->pmtGenerator.initPmt(channel->pmtPid, pmtSection, pids);
-		insertPatPmt();
+		internal->insertPatPmt();
+	}
+
+	internal->seekIndex.setStreams(videoPid, pmtParser.videoStreamType, pcrPid);
+	internal->liveClock.setStreams(videoPid, pmtParser.videoStreamType, pcrPid);
+}
+
+// memory tier; multiple of the packet size (~ 48 MiB)
+static const int liveStreamSize = (188 * 256 * 1024);
+
+DvbLiveViewStream::DvbLiveViewStream() : diskWriter(this), diskLimit(0), diskFd(-1),
+	diskSize(0), diskOffset(0), diskStartOffset(0), diskStopped(true), maxDuration(0),
+	writeOffset(0), readOffset(0), startOffset(0), writeTime(-1), resetCount(0), aborted(false)
+{
+}
+
+DvbLiveViewStream::~DvbLiveViewStream()
+{
+	stopDiskRing();
+}
+
+void DvbLiveViewStream::setLimits(const QString &folder, qint64 diskSize_, int maxDuration_)
+{
+	// the ring has to contain whole packets
+	diskSize_ -= (diskSize_ % 188);
+
+	if (diskSize_ <= liveStreamSize) {
+		diskSize_ = 0;
+	}
+
+	{
+		QMutexLocker locker(&mutex);
+		maxDuration = maxDuration_;
+
+		if (diskWriter.isRunning() && (diskSize_ == diskLimit) && (folder == diskFolder)) {
+			return;
+		}
+	}
+
+	stopDiskRing();
+
+	if (diskSize_ == 0) {
+		return;
+	}
+
+	QMutexLocker locker(&mutex);
+	diskFolder = folder;
+	diskLimit = diskSize_;
+	diskStopped = false;
+	diskWriter.start(QThread::LowPriority);
+}
+
+void DvbLiveViewStream::stopDiskRing()
+{
+	{
+		QMutexLocker locker(&mutex);
+		diskStopped = true;
+		diskDataAvailable.wakeAll();
+	}
+
+	diskWriter.wait();
+}
+
+void DvbLiveViewStream::reset()
+{
+	QMutexLocker locker(&mutex);
+	ringBuffer.clear();
+	diskOffset = 0;
+	diskStartOffset = 0;
+	writeOffset = 0;
+	readOffset = 0;
+	startOffset = 0;
+	writeTime = -1;
+	++resetCount;
+	timeEntries.clear();
+}
+
+void DvbLiveViewStream::write(const char *data, int size, int time)
+{
+	QMutexLocker locker(&mutex);
+
+	if (ringBuffer.isEmpty()) {
+		ringBuffer.resize(liveStreamSize);
+	}
+
+	int position = int(writeOffset % liveStreamSize);
+	int firstSize = qMin(size, liveStreamSize - position);
+	memcpy(ringBuffer.data() + position, data, firstSize);
+	memcpy(ringBuffer.data(), data + firstSize, size - firstSize);
+
+	writeOffset += size;
+
+	if (time >= 0) {
+		writeTime = time;
+	}
+
+	// remove the entries whose data has been overwritten or which are too old
+	qint64 oldest = oldestOffset();
+	int count = 0;
+
+	while (count < timeEntries.size()) {
+		const SeekIndexEntry &entry = timeEntries.at(count);
+
+		if ((entry.offset >= oldest) &&
+		    ((maxDuration <= 0) || ((writeTime - int(entry.time)) <= maxDuration))) {
+			break;
+		}
+
+		++count;
+	}
+
+	if (count > 0) {
+		timeEntries.remove(0, count);
+
+		if (!timeEntries.isEmpty()) {
+			startOffset = timeEntries.first().offset;
+		} else if (maxDuration > 0) {
+			startOffset = writeOffset;
+		}
+	}
+
+	dataAvailable.wakeAll();
+	diskDataAvailable.wakeAll();
+}
+
+void DvbLiveViewStream::addEntry(qint64 offset, int time)
+{
+	QMutexLocker locker(&mutex);
+	SeekIndexEntry entry;
+	entry.offset = offset;
+	entry.time = time;
+	entry.flags = SeekIndexEntry::RandomAccessPoint;
+	timeEntries.append(entry);
+}
+
+bool DvbLiveViewStream::open()
+{
+	QMutexLocker locker(&mutex);
+	aborted = false;
+	return true;
+}
+
+qint64 DvbLiveViewStream::read(char *data, qint64 size)
+{
+	QMutexLocker locker(&mutex);
+
+	while (true) {
+		while ((readOffset >= writeOffset) && !aborted) {
+			dataAvailable.wait(&mutex);
+		}
+
+		if (aborted) {
+			return 0;
+		}
+
+		qint64 oldest = oldestOffset();
+
+		if (readOffset < oldest) {
+			qCWarning(logDvb, "Time shift buffer overrun, skipping %lld bytes",
+				oldest - readOffset);
+			readOffset = oldest;
+		}
+
+		size = qMin(size, writeOffset - readOffset);
+
+		if (readOffset >= (writeOffset - liveStreamSize)) {
+			int position = int(readOffset % liveStreamSize);
+			int firstSize = int(qMin(size, qint64(liveStreamSize - position)));
+			memcpy(data, ringBuffer.constData() + position, firstSize);
+			memcpy(data + firstSize, ringBuffer.constData(), size - firstSize);
+			break;
+		}
+
+		// older data is only on disk; the disk is read without holding the mutex,
+		// so the data has to be checked afterwards (it may have been overwritten)
+		qint64 offset = readOffset;
+		int count = resetCount;
+		qint64 position = (offset % diskSize);
+		size = qMin(qMin(size, diskSize - position), diskOffset - offset);
+		locker.unlock();
+
+		ssize_t bytesRead = -1;
+		int error = EBADF;
+
+		{
+			QMutexLocker diskLocker(&diskMutex);
+
+			if (diskFd >= 0) {
+				bytesRead = pread(diskFd, data, size_t(size), position);
+				error = errno;
+			}
+		}
+
+		locker.relock();
+
+		if ((count != resetCount) || (offset != readOffset) || (offset < oldestOffset())) {
+			continue;
+		}
+
+		if (bytesRead <= 0) {
+			qCWarning(logDvb, "Error %d while reading from the time shift buffer", error);
+			return -1;
+		}
+
+		size = bytesRead;
+		break;
+	}
+
+	readOffset += size;
+	return size;
+}
+
+bool DvbLiveViewStream::seek(quint64 offset)
+{
+	QMutexLocker locker(&mutex);
+
+	if ((qint64(offset) < oldestOffset()) || (qint64(offset) > writeOffset)) {
+		return false;
+	}
+
+	readOffset = qint64(offset);
+	return true;
+}
+
+void DvbLiveViewStream::close()
+{
+}
+
+void DvbLiveViewStream::abort()
+{
+	QMutexLocker locker(&mutex);
+	aborted = true;
+	dataAvailable.wakeAll();
+}
+
+void DvbLiveViewStream::getCurrentTotalTime(int &currentTime, int &totalTime) const
+{
+	QMutexLocker locker(&mutex);
+
+	// the time line begins with the oldest data in the buffer
+	if (timeEntries.isEmpty() || (writeTime < 0)) {
+		currentTime = 0;
+		totalTime = 0;
+		return;
+	}
+
+	int firstTime = int(timeEntries.first().time);
+	totalTime = qMax(writeTime - firstTime, 0);
+	currentTime = qMax(findTime(readOffset) - firstTime, 0);
+}
+
+void DvbLiveViewStream::seekTime(int time)
+{
+	QMutexLocker locker(&mutex);
+
+	if (timeEntries.isEmpty()) {
+		return;
+	}
+
+	time += int(timeEntries.first().time);
+
+	// binary search for the last entry with entry.time <= time
+	int begin = 0;
+	int end = timeEntries.size();
+
+	while (begin < end) {
+		int middle = ((begin + end) / 2);
+
+		if (int(timeEntries.at(middle).time) <= time) {
+			begin = (middle + 1);
+		} else {
+			end = middle;
+		}
+	}
+
+	readOffset = qMin(timeEntries.at(qMax(begin - 1, 0)).offset, writeOffset);
+	dataAvailable.wakeAll();
+}
+
+void DvbLiveViewStream::runDiskWriter()
+{
+	QString fileName;
+	qint64 size;
+
+	{
+		QMutexLocker locker(&mutex);
+		fileName = diskFolder + QLatin1String("/TimeShift-") +
+			QString::number(QCoreApplication::applicationPid()) + QLatin1String(".ring");
+		size = diskLimit;
+	}
+
+	int fd = ::open(QFile::encodeName(fileName).constData(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+	if (fd < 0) {
+		qCWarning(logDvb, "Cannot open file %s", qPrintable(fileName));
+		return;
+	}
+
+	// the file is only accessed through the descriptor; the space is returned
+	// automatically when it is closed (also after a crash)
+	unlink(QFile::encodeName(fileName).constData());
+
+#ifdef FALLOC_FL_KEEP_SIZE
+	// reserve the space beforehand, so that disk usage stays constant; unlike
+	// posix_fallocate() it isn't emulated (by writing the whole file) if the file
+	// system doesn't support it; the file simply grows in that case
+	if ((fallocate(fd, 0, 0, size) != 0) && (errno == ENOSPC)) {
+		qCWarning(logDvb, "Cannot allocate %lld bytes for the time shift buffer", size);
+		::close(fd);
+		return;
+	}
+#endif
+
+	QByteArray chunk;
+	chunk.resize(188 * 5 * 1024);
+
+	{
+		QMutexLocker diskLocker(&diskMutex);
+		diskFd = fd;
+	}
+
+	QMutexLocker locker(&mutex);
+	diskSize = size;
+	// the data which is still in memory is written as well
+	diskOffset = qMax(writeOffset - liveStreamSize, Q_INT64_C(0));
+	diskStartOffset = diskOffset;
+
+	while (!diskStopped) {
+		if (diskOffset >= writeOffset) {
+			diskDataAvailable.wait(&mutex);
+			continue;
+		}
+
+		if (diskOffset < (writeOffset - liveStreamSize)) {
+			qCWarning(logDvb, "Disk too slow for the time shift buffer, skipping %lld bytes",
+				writeOffset - liveStreamSize - diskOffset);
+			diskOffset = (writeOffset - liveStreamSize);
+			diskStartOffset = diskOffset;
+		}
+
+		qint64 offset = diskOffset;
+		int position = int(offset % liveStreamSize);
+		qint64 diskPosition = (offset % size);
+		int chunkSize = int(qMin(qMin(writeOffset - offset, qint64(chunk.size())),
+			qMin(qint64(liveStreamSize - position), size - diskPosition)));
+		memcpy(chunk.data(), ringBuffer.constData() + position, chunkSize);
+		int count = resetCount;
+		// the old data at this position isn't available anymore
+		diskStartOffset = qMax(diskStartOffset, offset + chunkSize - size);
+		locker.unlock();
+
+		bool failed = (pwrite(fd, chunk.constData(), chunkSize, diskPosition) != chunkSize);
+		int error = errno;
+		locker.relock();
+
+		if (failed) {
+			qCWarning(logDvb, "Error %d while writing to the time shift buffer", error);
+			break;
+		}
+
+		if (count == resetCount) {
+			diskOffset = (offset + chunkSize);
+		}
 	}
+
+	diskSize = 0;
+	locker.unlock();
+
+	QMutexLocker diskLocker(&diskMutex);
+	diskFd = -1;
+	::close(fd);
+}
+
+void DvbLiveViewDiskWriter::run()
+{
+	stream->runDiskWriter();
 }
 
-DvbLiveViewInternal::DvbLiveViewInternal(QObject *parent) :
-	QObject(parent), mediaWidget(NULL), emptyBuffer(true), timeshift(false),
-	currentAudioStream(-1), currentSubtitle(-1), retryCounter(0),
-	readFd(-1), writeFd(-1), notifier(NULL)
+qint64 DvbLiveViewStream::oldestOffset() const
+{
+	qint64 oldest = (writeOffset - liveStreamSize);
+
+	// the disk ring continues the memory ring if the disk writer keeps up
+	if ((diskSize > 0) && (diskOffset >= oldest)) {
+		oldest = qMin(oldest, qMax(diskStartOffset, diskOffset - diskSize));
+	}
+
+	return qMax(qMax(oldest, startOffset), Q_INT64_C(0));
+}
+
+int DvbLiveViewStream::findTime(qint64 offset) const
+{
+	// binary search for the last entry with entry.offset <= offset
+	int begin = 0;
+	int end = timeEntries.size();
+
+	while (begin < end) {
+		int middle = ((begin + end) / 2);
+
+		if (timeEntries.at(middle).offset <= offset) {
+			begin = (middle + 1);
+		} else {
+			end = middle;
+		}
+	}
+
+	if (begin == 0) {
+		return (timeEntries.isEmpty() ? 0 : int(timeEntries.first().time));
+	}
+
+	return int(timeEntries.at(begin - 1).time);
+}
+
+void DvbLiveView::startZapBuffers()
+{
+	// each buffer adds pid filters and memory, so they have to be enabled explicitly
+	int maxZapBuffers = manager->getZapBufferCount();
+
+	if (maxZapBuffers <= 0) {
+		return;
+	}
+
+	// the nearest channel numbers on the same transponder are the likely zap targets
+	QMultiMap<int, DvbSharedChannel> candidates;
+
+	foreach (const DvbSharedChannel &otherChannel, manager->getChannelModel()->getChannels()) {
+		if ((otherChannel != channel) && (otherChannel->source == channel->source) &&
+		    otherChannel->transponder.corresponds(channel->transponder) &&
+		    !otherChannel->isScrambled && !otherChannel->pmtSectionData.isEmpty()) {
+			candidates.insert(qAbs(otherChannel->number - channel->number), otherChannel);
+		}
+	}
+
+	foreach (const DvbSharedChannel &otherChannel, candidates) {
+		if (zapBuffers.size() >= maxZapBuffers) {
+			break;
+		}
+
+		DvbZapBuffer *zapBuffer = new DvbZapBuffer(otherChannel);
+		QList<int> addedPids;
+
+		foreach (int pid, zapBuffer->pids) {
+			if (!device->addPidFilter(pid, zapBuffer)) {
+				// the hardware filters are needed more urgently by the live view
+				break;
+			}
+
+			addedPids.append(pid);
+		}
+
+		if (zapBuffer->pids.isEmpty() || (addedPids.size() != zapBuffer->pids.size())) {
+			foreach (int pid, addedPids) {
+				device->removePidFilter(pid, zapBuffer);
+			}
+
+			delete zapBuffer;
+			continue;
+		}
+
+		zapBuffers.append(zapBuffer);
+	}
+}
+
+void DvbLiveView::stopZapBuffers()
+{
+	foreach (DvbZapBuffer *zapBuffer, zapBuffers) {
+		foreach (int pid, zapBuffer->pids) {
+			device->removePidFilter(pid, zapBuffer);
+		}
+	}
+
+	// the device doesn't access removed filters anymore
+	qDeleteAll(zapBuffers);
+	zapBuffers.clear();
+}
+
+void DvbLiveView::updatePreTuning()
+{
+	// the neighbouring channel numbers, then the recently watched channels
+	QList<DvbSharedChannel> candidates;
+	QMap<int, DvbSharedChannel> channels = manager->getChannelModel()->getChannels();
+	QMap<int, DvbSharedChannel>::ConstIterator it = channels.constFind(channel->number);
+
+	if (it != channels.constEnd()) {
+		if ((it + 1) != channels.constEnd()) {
+			candidates.append(*(it + 1));
+		}
+
+		if (it != channels.constBegin()) {
+			candidates.append(*(it - 1));
+		}
+	}
+
+	candidates += recentChannels;
+	QList<QPair<QString, DvbTransponder> > transponders;
+
+	foreach (const DvbSharedChannel &candidate, candidates) {
+		if ((candidate->source == channel->source) &&
+		    candidate->transponder.corresponds(channel->transponder)) {
+			continue;
+		}
+
+		bool found = false;
+
+		for (int i = 0; i < transponders.size(); ++i) {
+			if ((transponders.at(i).first == candidate->source) &&
+			    transponders.at(i).second.corresponds(candidate->transponder)) {
+				found = true;
+				break;
+			}
+		}
+
+		if (!found) {
+			transponders.append(qMakePair(candidate->source, candidate->transponder));
+		}
+	}
+
+	manager->preTune(transponders);
+}
+
+// upper limit for a group of pictures (~ 4 MiB)
+static const int zapBufferSize = (22310 * 188);
+
+DvbZapBuffer::DvbZapBuffer(const DvbSharedChannel &channel_) : channel(channel_)
+{
+	DvbPmtSection pmtSection(channel->pmtSectionData);
+
+	if (!pmtSection.isValid()) {
+		return;
+	}
+
+	DvbPmtParser pmtParser(pmtSection);
+
+	if (pmtParser.videoPid < 0) {
+		// audio can be decoded immediately
+		return;
+	}
+
+	pids.append(pmtParser.videoPid);
+	int audioPid = -1;
+
+	for (int i = 0; i < pmtParser.audioPids.size(); ++i) {
+		if ((i == 0) || (pmtParser.audioPids.at(i).first == channel->audioPid)) {
+			audioPid = pmtParser.audioPids.at(i).first;
+		}
+	}
+
+	if (audioPid >= 0) {
+		pids.append(audioPid);
+	}
+
+	int pcrPid = pmtSection.pcrPid();
+
+	if ((pcrPid != 0x1fff) && !pids.contains(pcrPid)) {
+		pids.append(pcrPid);
+	}
+
+	seekIndex.setStreams(pmtParser.videoPid, pmtParser.videoStreamType, pcrPid);
+}
+
+QByteArray DvbZapBuffer::takeData()
+{
+	QByteArray data = buffer;
+	buffer.clear();
+	return data;
+}
+
+void DvbZapBuffer::processData(const char data[188])
+{
+	if (seekIndex.isRandomAccessPoint(data)) {
+		buffer.clear();
+	} else if (buffer.isEmpty()) {
+		return;
+	}
+
+	if (buffer.size() >= zapBufferSize) {
+		// too long; wait for the next random access point
+		buffer.clear();
+		return;
+	}
+
+	buffer.append(data, 188);
+}
+
+DvbLiveViewInternal::DvbLiveViewInternal(MediaWidget *mediaWidget_, QObject *parent) :
+	QObject(parent), mediaWidget(mediaWidget_), timeShiftStartTime(0), timeshift(false),
+	useStream(mediaWidget_->supportsStreams()), streamOffset(0), lastStreamEntryTime(-1),
+	currentAudioStream(-1), currentSubtitle(-1), readFd(-1), writeFd(-1), notifier(NULL),
+	pipeQueueBegin(0), pipeQueueLength(0), droppedPackets(0)
 {
 	fileName = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation) + QLatin1String("/dvbpipe.m2t");
 	QFile::remove(fileName);
 
 	updateUrl();
 
+	if (useStream) {
+		// the backend reads the data directly from 'stream'
+		return;
+	}
+
+	pipeQueue.resize(pipeQueueSize);
+
 	if (mkfifo(QFile::encodeName(fileName).constData(), 0600) != 0) {
 		qCWarning(logDvb, "Failed to open a fifo. Error: %d", errno);
 		return;
@@ -623,8 +1270,6 @@ DvbLiveViewInternal::DvbLiveViewInternal(QObject *parent) :
 	notifier = new QSocketNotifier(writeFd, QSocketNotifier::Write, this);
 	notifier->setEnabled(false);
 	connect(notifier, SIGNAL(activated(int)), this, SLOT(writeToPipe()));
-
-	emptyBuffer = true;
 }
 
 DvbLiveViewInternal::~DvbLiveViewInternal()
@@ -640,80 +1285,130 @@ DvbLiveViewInternal::~DvbLiveViewInternal()
 
 void DvbLiveViewInternal::resetPipe()
 {
-	retryCounter = 0;
-	notifier->setEnabled(false);
-
-	if (!buffers.isEmpty()) {
-		buffer = buffers.at(0);
-		buffers.clear();
+	liveClock.resetTime();
+	timeShiftStartTime = 0;
+
+	if (useStream) {
+		stream.reset();
+		streamOffset = 0;
+		lastStreamEntryTime = -1;
+		buffer.clear();
+		return;
 	}
 
-	if (readFd >= 0) {
-		if (buffer.isEmpty()) {
-			buffer.resize(87 * 188);
-		}
+	notifier->setEnabled(false);
+	pipeQueueBegin = 0;
+	pipeQueueLength = 0;
+	droppedPackets = 0;
 
-		while (read(readFd, buffer.data(), buffer.size()) > 0) {
+	if (readFd >= 0) {
+		while (read(readFd, pipeQueue.data(), pipeQueue.size()) > 0) {
 		}
 	}
 
-	emptyBuffer = true;
 	buffer.clear();
 }
 
 void DvbLiveViewInternal::writeToPipe()
 {
-	if (buffers.isEmpty()) {
-		// disable notifier if the buffers are empty
-		notifier->setEnabled(false);
-		return;
-	}
+	while (pipeQueueLength > 0) {
+		struct iovec vector[2];
+		int count = 1;
+		int firstSize = qMin(pipeQueueLength, pipeQueueSize - pipeQueueBegin);
+		vector[0].iov_base = pipeQueue.data() + pipeQueueBegin;
+		vector[0].iov_len = firstSize;
+
+		if (firstSize < pipeQueueLength) {
+			vector[1].iov_base = pipeQueue.data();
+			vector[1].iov_len = (pipeQueueLength - firstSize);
+			count = 2;
+		}
 
-	do {
-		const QByteArray &currentBuffer = buffers.at(0);
-		int bytesWritten = int(write(writeFd, currentBuffer.constData(), currentBuffer.size()));
+		int bytesWritten = int(writev(writeFd, vector, count));
 
 		if (bytesWritten < 0) {
 			// Some interrupt happened while writing. Retry.
 			if (errno == EINTR)
 				continue;
 
-			if (++retryCounter > 50) {
-				// Too much failures. Warn the user
-				qCWarning(logDvb, "Stream seems to be too havy to be displayed");
-				return;
-			}
-
 			// EAGAIN may happen when the pipe is full.
 			// That's a normal condition. No need to report.
 			if (!IS_EAGAIN(errno))
 				qCWarning(logDvb, "Error %d while writing to pipe", errno);
-		} else {
-			retryCounter = 0;
-			if (bytesWritten == currentBuffer.size()) {
-				buffers.removeFirst();
-				continue;
+
+			break;
+		}
+
+		pipeQueueBegin = ((pipeQueueBegin + bytesWritten) % pipeQueueSize);
+		pipeQueueLength -= bytesWritten;
+	}
+
+	// Wait for a notification that writeFd is ready to write
+	notifier->setEnabled(pipeQueueLength > 0);
+}
+
+void DvbLiveViewInternal::pushToPipe(const char *data, int size)
+{
+	if (pipeQueueLength > 0) {
+		writeToPipe();
+	}
+
+	int offset = 0;
+
+	if (pipeQueueLength == 0) {
+		// common case: the data goes directly from 'buffer' into the pipe
+		while (offset < size) {
+			int bytesWritten = int(write(writeFd, data + offset, size - offset));
+
+			if (bytesWritten < 0) {
+				if (errno == EINTR)
+					continue;
+
+				if (!IS_EAGAIN(errno))
+					qCWarning(logDvb, "Error %d while writing to pipe", errno);
+
+				break;
 			}
-			if (bytesWritten > 0)
-				buffers.first().remove(0, bytesWritten);
+
+			offset += bytesWritten;
 		}
-		// If bytesWritten is less than buffer size, or returns an
-		// error, there's no sense on wasting CPU time inside a loop
-		break;
-	} while (!buffers.isEmpty());
+	}
 
-	if (!buffers.isEmpty()) {
-		// Wait for a notification that writeFd is ready to write
-		notifier->setEnabled(true);
+	// the rest of a partially written packet has to be queued; if the queue
+	// is full, the remaining (whole) packets are dropped
+	int pendingSize = (size - offset);
+	int partialSize = ((188 - (offset % 188)) % 188);
+	int queuedSize = qMin(pendingSize, pipeQueueSize - pipeQueueLength);
+	queuedSize = (partialSize + (((queuedSize - partialSize) / 188) * 188));
+
+	int position = ((pipeQueueBegin + pipeQueueLength) % pipeQueueSize);
+	int firstSize = qMin(queuedSize, pipeQueueSize - position);
+	memcpy(pipeQueue.data() + position, data + offset, firstSize);
+	memcpy(pipeQueue.data(), data + offset + firstSize, queuedSize - firstSize);
+	pipeQueueLength += queuedSize;
+
+	if (queuedSize < pendingSize) {
+		if (droppedPackets == 0) {
+			qCWarning(logDvb, "Stream seems to be too heavy to be displayed, dropping packets");
+		}
+
+		droppedPackets += ((pendingSize - queuedSize) / 188);
+	} else if ((droppedPackets > 0) && (pipeQueueLength == 0)) {
+		qCWarning(logDvb, "Dropped %d packets because the player was too slow", droppedPackets);
+		droppedPackets = 0;
 	}
+
+	notifier->setEnabled(pipeQueueLength > 0);
 }
 
 void DvbLiveViewInternal::validateCurrentTotalTime(int &currentTime, int &totalTime) const
 {
-	if (emptyBuffer)
+	// the times of the stream are provided by the backend
+	if (useStream || (liveClock.time() < 0))
 		return;
 
-	totalTime = startTime.msecsTo(QTime::currentTime());
+	// the time shift file starts when playback was paused
+	totalTime = int(liveClock.time() - timeShiftStartTime);
 
 	// Adjust it, if needed
 	if (currentTime > totalTime)
@@ -722,32 +1417,66 @@ void DvbLiveViewInternal::validateCurrentTotalTime(int &currentTime, int &totalT
 }
 
 
+void DvbLiveViewInternal::prebuffer(const QByteArray &data)
+{
+	for (int i = 0; (i + 188) <= data.size(); i += 188) {
+		processData(data.constData() + i);
+	}
+}
+
+void DvbLiveViewInternal::insertPatPmt()
+{
+	buffer.append(patGenerator.generatePackets());
+	buffer.append(pmtGenerator.generatePackets());
+	patPmtRepetition.reset();
+}
+
 void DvbLiveViewInternal::processData(const char data[188])
 {
+	// the stream type of the video pid is known by the seek index (also
+	// if there's no time shift file)
+	bool randomAccessPoint = seekIndex.isRandomAccessPoint(data);
+	liveClock.processPcr(data);
+
+	if (useStream) {
+		qint64 time = liveClock.time();
+
+		// playback can start at the pat / pmt which is inserted before the
+		// random access point; streams without video use one entry per second
+		if ((time >= 0) && (seekIndex.hasVideo() ? randomAccessPoint :
+		    ((lastStreamEntryTime < 0) || ((time - lastStreamEntryTime) >= 1000)))) {
+			stream.addEntry(streamOffset + buffer.size(), int(time));
+			lastStreamEntryTime = time;
+		}
+	}
+
+	if (patPmtRepetition.check(randomAccessPoint, liveClock.time())) {
+		insertPatPmt();
+	}
+
 	buffer.append(data, 188);
 
 	if (buffer.size() < (87 * 188)) {
 		return;
 	}
 
-	if (!timeShiftFile.isOpen()) {
+	if (useStream) {
+		stream.write(buffer.constData(), buffer.size(), int(liveClock.time()));
+		streamOffset += buffer.size();
+	} else if (!timeShiftFile.isOpen()) {
 		if (writeFd >= 0) {
-			buffers.append(buffer);
-			writeToPipe();
-			if (emptyBuffer) {
-				startTime = QTime::currentTime();
-				emptyBuffer = false;
-			}
+			pushToPipe(buffer.constData(), buffer.size());
 		}
 	} else {
 		notifier->setEnabled(false);
-		timeShiftFile.write(buffer); // FIXME avoid buffer reallocation
-		if (emptyBuffer) {
-			startTime = QTime::currentTime();
-			emptyBuffer = false;
+
+		for (int i = 0; i < buffer.size(); i += 188) {
+			seekIndex.processPacket(buffer.constData() + i, timeShiftFile.pos() + i);
 		}
+
+		timeShiftFile.write(buffer); // FIXME avoid buffer reallocation
 	}
 
-	buffer.clear();
-	buffer.reserve(87 * 188);
+	// keeps the reserved capacity
+	buffer.resize(0);
 }
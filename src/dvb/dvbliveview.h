@@ -28,6 +28,7 @@
 class DvbDevice;
 class DvbLiveViewInternal;
 class DvbManager;
+class DvbZapBuffer;
 
 class DvbLiveView : public QObject
 {
@@ -50,7 +51,6 @@ signals:
 
 private slots:
 	void pmtSectionChanged(const QByteArray &pmtSectionData);
-	void insertPatPmt();
 	void deviceStateChanged();
 	void showOsd();
 	void osdTimeout();
@@ -65,6 +65,9 @@ private:
 	void startDevice();
 	void stopDevice();
 	void updatePids(bool forcePatPmtUpdate = false);
+	void startZapBuffers();
+	void stopZapBuffers();
+	void updatePreTuning();
 
 	DvbManager *manager;
 	MediaWidget *mediaWidget;
@@ -74,13 +77,16 @@ private:
 	DvbSharedChannel channel;
 	DvbDevice *device;
 	QList<int> pids;
-	QTimer patPmtTimer;
+	QList<DvbZapBuffer *> zapBuffers;
+	QByteArray zapData; // used by the next replay()
+	QList<DvbSharedChannel> recentChannels; // most recent first
+	bool zapping;
 	QTimer osdTimer;
 
 	int videoPid;
 	int audioPid;
 	int subtitlePid;
-	int pausedTime;
+	int pausedTime; // ms on the live clock of the pipe
 	QList<int> audioPids;
 	QList<int> subtitlePids;
 };
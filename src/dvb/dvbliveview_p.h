@@ -22,8 +22,12 @@
 #define DVBLIVEVIEW_P_H
 
 #include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
 #include "../mediawidget.h"
 #include "../osdwidget.h"
+#include "../seekindex.h"
 #include "dvbepg.h"
 #include "dvbsi.h"
 #include "dvbmanager.h"
@@ -56,14 +60,113 @@ private:
 	DvbManager *manager;
 };
 
+class DvbLiveViewStream;
+
+// writes the live stream to the disk ring, so that the disk is never accessed by
+// the thread which demuxes the data
+
+class DvbLiveViewDiskWriter : public QThread
+{
+public:
+	explicit DvbLiveViewDiskWriter(DvbLiveViewStream *stream_) : stream(stream_) { }
+	~DvbLiveViewDiskWriter() { }
+
+private:
+	void run() override;
+
+	DvbLiveViewStream *stream;
+};
+
+// circular time shift buffer of the live stream; it is written by the main thread
+// and read by the backend (pausing and seeking stay within the buffer)
+// the most recent data is kept in memory; if a disk ring is configured, the disk
+// writer copies the data from memory to a file of fixed size
+
+class DvbLiveViewStream : public MediaStream
+{
+	friend class DvbLiveViewDiskWriter;
+public:
+	DvbLiveViewStream();
+	~DvbLiveViewStream();
+
+	// 'diskSize' = 0 means memory only; 'maxDuration' (ms) = 0 means unlimited
+	// the disk ring is created by the disk writer (the memory is used meanwhile)
+	void setLimits(const QString &folder, qint64 diskSize_, int maxDuration_);
+	// closes the disk ring and frees its space (live view stopped)
+	void stopDiskRing();
+	void reset(); // discards the data (channel change)
+	// 'time' is the pcr based time (ms) of the end of the data; -1 = unknown
+	void write(const char *data, int size, int time);
+	// marks a position which playback can start from (random access point)
+	void addEntry(qint64 offset, int time);
+
+	bool open() override;
+	qint64 read(char *data, qint64 size) override;
+	bool seek(quint64 offset) override;
+	void close() override;
+	void abort() override;
+	void getCurrentTotalTime(int &currentTime, int &totalTime) const override;
+	void seekTime(int time) override;
+
+private:
+	void runDiskWriter(); // called by the disk writer thread
+	qint64 oldestOffset() const;
+	int findTime(qint64 offset) const;
+
+	mutable QMutex mutex;
+	QWaitCondition dataAvailable;
+	QWaitCondition diskDataAvailable;
+	QByteArray ringBuffer;
+	DvbLiveViewDiskWriter diskWriter;
+	QMutex diskMutex; // the descriptor isn't closed while it is being read
+	QString diskFolder;
+	qint64 diskLimit; // configured size of the disk ring
+	int diskFd;
+	qint64 diskSize; // 0 = disk ring not available
+	qint64 diskOffset; // data before it has been written to the disk ring
+	qint64 diskStartOffset; // data before it isn't (or no longer) on disk
+	bool diskStopped;
+	int maxDuration;
+	qint64 writeOffset; // number of bytes written since reset()
+	qint64 readOffset;
+	qint64 startOffset; // data before it is older than 'maxDuration'
+	int writeTime;
+	int resetCount;
+	bool aborted;
+	QVector<SeekIndexEntry> timeEntries;
+};
+
+// keeps the packets of another channel of the transponder since the last random
+// access point, so that a zap to this channel can start with a decodable picture
+
+class DvbZapBuffer : public DvbPidFilter
+{
+public:
+	explicit DvbZapBuffer(const DvbSharedChannel &channel_);
+	~DvbZapBuffer() { }
+
+	QByteArray takeData(); // returns and clears the buffered packets
+
+	DvbSharedChannel channel;
+	QList<int> pids; // empty if the channel has no video
+
+private:
+	void processData(const char data[188]) override;
+
+	SeekIndexWriter seekIndex; // only used to find the random access points
+	QByteArray buffer; // empty until the first random access point
+};
+
 class DvbLiveViewInternal : public QObject, public DvbPidFilter, public MediaSource
 {
 	Q_OBJECT
 public:
-	explicit DvbLiveViewInternal(QObject *parent);
+	DvbLiveViewInternal(MediaWidget *mediaWidget_, QObject *parent);
 	~DvbLiveViewInternal();
 
 	void resetPipe();
+	void insertPatPmt();
+	void prebuffer(const QByteArray &data); // see DvbZapBuffer
 
 	bool overrideAudioStreams() const override { return !audioStreams.isEmpty(); }
 	QStringList getAudioStreams() const override { return audioStreams; }
@@ -91,6 +194,12 @@ public:
 
 	QUrl getUrl() const override { return url; }
 
+	MediaStream *getStream() const override
+	{
+		// the backend reads the stream from another thread
+		return (useStream ? const_cast<DvbLiveViewStream *>(&stream) : NULL);
+	}
+
 	void updateUrl() {
 		if (timeShiftFile.isOpen())
 			url = QUrl::fromLocalFile(timeShiftFile.fileName());
@@ -99,7 +208,7 @@ public:
 	}
 
 	virtual void validateCurrentTotalTime(int &currentTime, int &totalTime) const override;
-	bool hideCurrentTotalTime() const override { return !timeshift; }
+	bool hideCurrentTotalTime() const override { return (!useStream && !timeshift); }
 
 	MediaWidget *mediaWidget;
 	QString channelName;
@@ -107,17 +216,22 @@ public:
 	QByteArray pmtSectionData;
 	DvbSectionGenerator patGenerator;
 	DvbSectionGenerator pmtGenerator;
+	DvbPatPmtRepetition patPmtRepetition;
 	QByteArray buffer;
 	QFile timeShiftFile;
+	SeekIndexWriter seekIndex;
+	SeekIndexWriter liveClock; // pcr based time line since the start of playback
+	qint64 timeShiftStartTime; // time of 'liveClock' when 'timeShiftFile' was opened
 	QString fileName;
 	DvbOsd dvbOsd;
-	bool emptyBuffer;
-	QTime startTime;
 	bool timeshift;
+	bool useStream; // false = the data is passed through a fifo
+	DvbLiveViewStream stream;
+	qint64 streamOffset; // number of bytes passed to 'stream'
+	qint64 lastStreamEntryTime;
 	QStringList audioStreams;
 	int currentAudioStream;
 	int currentSubtitle;
-	int retryCounter;
 
 signals:
 	void currentAudioStreamChanged(int currentAudioStream);
@@ -133,12 +247,16 @@ private slots:
 
 private:
 	void processData(const char data[188]) override;
+	void pushToPipe(const char *data, int size);
 
 	QUrl url;
 	int readFd;
 	int writeFd;
 	QSocketNotifier *notifier;
-	QList<QByteArray> buffers;
+	QByteArray pipeQueue; // ring buffer
+	int pipeQueueBegin;
+	int pipeQueueLength;
+	int droppedPackets; // since the queue was last empty
 };
 
 #endif /* DVBLIVEVIEW_P_H */
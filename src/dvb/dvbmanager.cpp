@@ -36,10 +36,12 @@
 #include "dvbmanager.h"
 #include "dvbmanager_p.h"
 #include "dvbsi.h"
+#include "dvbstreamserver.h"
 #include "xmltv.h"
 
 DvbManager::DvbManager(MediaWidget *mediaWidget_, QWidget *parent_) : QObject(parent_),
-	parent(parent_), mediaWidget(mediaWidget_), channelView(NULL), dvbDumpEnabled(false)
+	parent(parent_), mediaWidget(mediaWidget_), channelView(NULL), streamServer(NULL),
+	dvbDumpEnabled(false)
 {
 	channelModel = DvbChannelModel::createSqlModel(this);
 	recordingModel = new DvbRecordingModel(this, this);
@@ -52,6 +54,10 @@ DvbManager::DvbManager(MediaWidget *mediaWidget_, QWidget *parent_) : QObject(pa
 
 	loadDeviceManager();
 
+	if (getStreamServerPort() > 0) {
+		streamServer = new DvbStreamServer(this, getStreamServerPort(), this);
+	}
+
 	DvbSiText::setOverride6937(override6937Charset());
 
 	QString xmlFile = getXmltvFileName();
@@ -66,6 +72,7 @@ DvbManager::~DvbManager()
 
 	// we need an explicit deletion order (device users ; devices ; device manager)
 
+	delete streamServer;
 	delete xmlTv;
 	delete epgModel;
 	epgModel = NULL;
@@ -104,28 +111,53 @@ DvbDevice *DvbManager::requestDevice(const QString &source, const DvbTransponder
 	for (int i = 0; i < deviceConfigs.size(); ++i) {
 		const DvbDeviceConfig &it = deviceConfigs.at(i);
 
-		if ((it.device == NULL) || (it.useCount != 0)) {
-			continue;
+		if ((it.device != NULL) && it.preTuned && (it.source == source) &&
+		    it.transponder.corresponds(transponder)) {
+			// the prediction was right; the device is already tuned
+			deviceConfigs[i].preTuned = false;
+			deviceConfigs[i].useCount = 1;
+
+			if (requestType == Prioritized) {
+				deviceConfigs[i].prioritizedUseCount = 1;
+			}
+
+			return it.device;
 		}
+	}
 
-		foreach (const DvbConfig &config, it.configs) {
-			if (config->name == source) {
-				DvbDevice *device = it.device;
+	// idle devices are used before pre-tuned ones
+	for (int pass = 0; pass < 2; ++pass) {
+		for (int i = 0; i < deviceConfigs.size(); ++i) {
+			const DvbDeviceConfig &it = deviceConfigs.at(i);
 
-				if (!device->acquire(config.constData())) {
-					continue;
-				}
+			if ((it.device == NULL) || (it.useCount != 0) || (it.preTuned != (pass == 1))) {
+				continue;
+			}
 
-				deviceConfigs[i].useCount = 1;
+			foreach (const DvbConfig &config, it.configs) {
+				if (config->name == source) {
+					DvbDevice *device = it.device;
+
+					if (it.preTuned) {
+						// the device is handed out (it stays acquired), so only
+						// now the prediction is given up
+						device->reacquire(config.constData());
+						deviceConfigs[i].preTuned = false;
+					} else if (!device->acquire(config.constData())) {
+						continue;
+					}
 
-				if (requestType == Prioritized) {
-					deviceConfigs[i].prioritizedUseCount = 1;
-				}
+					deviceConfigs[i].useCount = 1;
 
-				deviceConfigs[i].source = source;
-				deviceConfigs[i].transponder = transponder;
-				device->tune(transponder);
-				return device;
+					if (requestType == Prioritized) {
+						deviceConfigs[i].prioritizedUseCount = 1;
+					}
+
+					deviceConfigs[i].source = source;
+					deviceConfigs[i].transponder = transponder;
+					device->tune(transponder);
+					return device;
+				}
 			}
 		}
 	}
@@ -162,6 +194,12 @@ DvbDevice *DvbManager::requestDevice(const QString &source, const DvbTransponder
 
 DvbDevice *DvbManager::requestExclusiveDevice(const QString &source)
 {
+	for (int i = 0; i < deviceConfigs.size(); ++i) {
+		if (deviceConfigs.at(i).preTuned) {
+			cancelPreTuning(i);
+		}
+	}
+
 	for (int i = 0; i < deviceConfigs.size(); ++i) {
 		const DvbDeviceConfig &it = deviceConfigs.at(i);
 
@@ -221,6 +259,92 @@ void DvbManager::releaseDevice(DvbDevice *device, RequestType requestType)
 	}
 }
 
+void DvbManager::preTune(const QList<QPair<QString, DvbTransponder> > &transponders)
+{
+	if (!isPreTuning()) {
+		return;
+	}
+
+	// give up predictions which aren't wanted anymore
+	for (int i = 0; i < deviceConfigs.size(); ++i) {
+		const DvbDeviceConfig &it = deviceConfigs.at(i);
+
+		if (!it.preTuned) {
+			continue;
+		}
+
+		bool wanted = false;
+
+		for (int j = 0; j < transponders.size(); ++j) {
+			if ((it.source == transponders.at(j).first) &&
+			    it.transponder.corresponds(transponders.at(j).second)) {
+				wanted = true;
+				break;
+			}
+		}
+
+		if (!wanted) {
+			cancelPreTuning(i);
+		}
+	}
+
+	for (int j = 0; j < transponders.size(); ++j) {
+		const QString &source = transponders.at(j).first;
+		const DvbTransponder &transponder = transponders.at(j).second;
+		int freeIndex = -1;
+		bool alreadyTuned = false;
+
+		for (int i = 0; i < deviceConfigs.size(); ++i) {
+			const DvbDeviceConfig &it = deviceConfigs.at(i);
+
+			if (it.device == NULL) {
+				continue;
+			}
+
+			if (((it.useCount > 0) || it.preTuned) && (it.source == source) &&
+			    it.transponder.corresponds(transponder)) {
+				alreadyTuned = true;
+				break;
+			}
+
+			if ((freeIndex < 0) && (it.useCount == 0) && !it.preTuned) {
+				foreach (const DvbConfig &config, it.configs) {
+					if (config->name == source) {
+						freeIndex = i;
+						break;
+					}
+				}
+			}
+		}
+
+		if (alreadyTuned || (freeIndex < 0)) {
+			continue;
+		}
+
+		DvbDevice *device = deviceConfigs.at(freeIndex).device;
+
+		foreach (const DvbConfig &config, deviceConfigs.at(freeIndex).configs) {
+			if ((config->name == source) && device->acquire(config.constData())) {
+				qCDebug(logDvb, "Pre-tuning %s", qPrintable(device->getFrontendName()));
+				deviceConfigs[freeIndex].preTuned = true;
+				deviceConfigs[freeIndex].source = source;
+				deviceConfigs[freeIndex].transponder = transponder;
+				device->tune(transponder);
+				break;
+			}
+		}
+	}
+}
+
+void DvbManager::cancelPreTuning(int index)
+{
+	DvbDeviceConfig &it = deviceConfigs[index];
+	Q_ASSERT(it.preTuned && (it.useCount == 0));
+	it.preTuned = false;
+	it.source.clear();
+	it.device->release();
+}
+
 QList<DvbDeviceConfig> DvbManager::getDeviceConfigs() const
 {
 	return deviceConfigs;
@@ -228,6 +352,13 @@ QList<DvbDeviceConfig> DvbManager::getDeviceConfigs() const
 
 void DvbManager::updateDeviceConfigs(const QList<DvbDeviceConfigUpdate> &configUpdates)
 {
+	// the devices keep pointers to the configs
+	for (int i = 0; i < deviceConfigs.size(); ++i) {
+		if (deviceConfigs.at(i).preTuned) {
+			cancelPreTuning(i);
+		}
+	}
+
 	for (int i = 0; i < configUpdates.size(); ++i) {
 		const DvbDeviceConfigUpdate &configUpdate = configUpdates.at(i);
 
@@ -370,6 +501,16 @@ int DvbManager::getEndMargin() const
 	return KSharedConfig::openConfig()->group("DVB").readEntry("EndMargin", 600);
 }
 
+int DvbManager::getPrePmtBufferSize() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("PrePmtBufferSize", 16384);
+}
+
+int DvbManager::getPrePmtBufferTime() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("PrePmtBufferTime", 10);
+}
+
 QString DvbManager::getNamingFormat() const
 {
 	return KSharedConfig::openConfig()->group("DVB").readEntry("NamingFormat", "%title");
@@ -390,6 +531,11 @@ QList<int> DvbManager::getRecordingRegexPriorityList() const
 	return KSharedConfig::openConfig()->group("DVB").readEntry("RecordingRegexPriorityList", QList<int>());
 }
 
+QString DvbManager::getRecordingProfile() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("RecordingProfile", "");
+}
+
 QString DvbManager::getActionAfterRecording() const
 {
 	return KSharedConfig::openConfig()->group("DVB").readEntry("ActionAfterRecording", "");
@@ -405,6 +551,11 @@ bool DvbManager::isScanWhenIdle() const
 	return KSharedConfig::openConfig()->group("DVB").readEntry("ScanWhenIdle", false);
 }
 
+bool DvbManager::isMuxCapture() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("MuxCapture", false);
+}
+
 bool DvbManager::createInfoFile() const
 {
 	return KSharedConfig::openConfig()->group("DVB").readEntry("CreateInfoFile", false);
@@ -415,6 +566,57 @@ bool DvbManager::disableEpg() const
 	return KSharedConfig::openConfig()->group("DVB").readEntry("DisableEpg", false);
 }
 
+bool DvbManager::recordingDirectIo() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("RecordingDirectIo", false);
+}
+
+bool DvbManager::recordingDropCache() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("RecordingDropCache", false);
+}
+
+int DvbManager::getRecordingSegmentDuration() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("RecordingSegmentDuration", 0);
+}
+
+bool DvbManager::isRecordingRunningStatus() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("RecordingRunningStatus", false);
+}
+
+bool DvbManager::isPreTuning() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("PreTuneDevices", false);
+}
+
+int DvbManager::getZapBufferCount() const
+{
+	int count = KSharedConfig::openConfig()->group("DVB").readEntry("ZapBuffers", 0);
+	return qBound(0, count, 2);
+}
+
+int DvbManager::getTimeShiftBufferSize() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("TimeShiftBufferSize", 2);
+}
+
+int DvbManager::getTimeShiftBufferDuration() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("TimeShiftBufferDuration", 60);
+}
+
+bool DvbManager::isParallelScan() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("ParallelScan", false);
+}
+
+int DvbManager::getStreamServerPort() const
+{
+	return KSharedConfig::openConfig()->group("DVB").readEntry("StreamServerPort", 0);
+}
+
 void DvbManager::setRecordingFolder(const QString &path)
 {
 	KSharedConfig::openConfig()->group("DVB").writeEntry("RecordingFolder", path);
@@ -425,6 +627,16 @@ void DvbManager::setTimeShiftFolder(const QString &path)
 	KSharedConfig::openConfig()->group("DVB").writeEntry("TimeShiftFolder", path);
 }
 
+void DvbManager::setTimeShiftBufferSize(int size)
+{
+	KSharedConfig::openConfig()->group("DVB").writeEntry("TimeShiftBufferSize", size);
+}
+
+void DvbManager::setTimeShiftBufferDuration(int duration)
+{
+	KSharedConfig::openConfig()->group("DVB").writeEntry("TimeShiftBufferDuration", duration);
+}
+
 void DvbManager::setXmltvFileName(const QString &path)
 {
 	KSharedConfig::openConfig()->group("DVB").writeEntry("XmltvFileName", path);
@@ -455,11 +667,13 @@ void DvbManager::setRecordingRegex(QString regex)
 void DvbManager::setRecordingRegexList(const QStringList regexList)
 {
 	KSharedConfig::openConfig()->group("DVB").writeEntry("RecordingRegexList", regexList);
+	recordingModel->invalidateRecordingRegexes();
 }
 
 void DvbManager::setRecordingRegexPriorityList(const QList<int> regexList)
 {
 	KSharedConfig::openConfig()->group("DVB").writeEntry("RecordingRegexPriorityList", regexList);
+	recordingModel->invalidateRecordingRegexes();
 }
 
 bool DvbManager::addRecordingRegex(QString regex)
@@ -580,9 +794,10 @@ void DvbManager::deviceRemoved(DvbBackendDevice *backendDevice)
 		DvbDeviceConfig &it = deviceConfigs[i];
 
 		if (it.device && it.device->getBackendDevice() == backendDevice) {
-			if (it.useCount != 0) {
+			if ((it.useCount != 0) || it.preTuned) {
 				it.useCount = 0;
 				it.prioritizedUseCount = 0;
+				it.preTuned = false;
 				it.device->release();
 			}
 
@@ -975,7 +1190,7 @@ void DvbManager::readScanData()
 
 DvbDeviceConfig::DvbDeviceConfig(const QString &deviceId_, const QString &frontendName_,
 	DvbDevice *device_) : deviceId(deviceId_), frontendName(frontendName_), device(device_),
-	useCount(0), prioritizedUseCount(0)
+	useCount(0), prioritizedUseCount(0), preTuned(false)
 {
 }
 
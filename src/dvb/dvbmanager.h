@@ -39,6 +39,7 @@ class DvbEpgModel;
 class DvbLiveView;
 class DvbRecordingModel;
 class DvbScanData;
+class DvbStreamServer;
 class MediaWidget;
 class XmlTv;
 
@@ -114,6 +115,10 @@ public:
 		RequestType requestType);
 	DvbDevice *requestExclusiveDevice(const QString &source);
 	void releaseDevice(DvbDevice *device, RequestType requestType);
+	// tunes idle devices to the given transponders (source, transponder), so that
+	// a later request only has to wait for the psi; such a device is given up as
+	// soon as a request can't be served otherwise
+	void preTune(const QList<QPair<QString, DvbTransponder> > &transponders);
 
 	QList<DvbDeviceConfig> getDeviceConfigs() const;
 	void updateDeviceConfigs(const QList<DvbDeviceConfigUpdate> &configUpdates);
@@ -134,14 +139,30 @@ public:
 	QStringList getRecordingRegexList() const;
 	QList<int> getRecordingRegexPriorityList() const;
 	QString getActionAfterRecording() const;
+	QString getRecordingProfile() const; // see DvbRecordingProfile
 	int getBeginMargin() const; // seconds
 	int getEndMargin() const; // seconds
+	int getPrePmtBufferSize() const; // KiB
+	int getPrePmtBufferTime() const; // seconds
 	bool override6937Charset() const;
 	bool createInfoFile() const;
 	bool disableEpg() const;
 	bool isScanWhenIdle() const;
+	bool isParallelScan() const; // use all idle devices of the source for a scan
+	bool isMuxCapture() const; // record whole transponders and split them later
+	bool recordingDirectIo() const; // bypass the page cache (O_DIRECT)
+	bool recordingDropCache() const; // drop written data from the page cache
+	int getRecordingSegmentDuration() const; // seconds, 0 = one file per recording
+	bool isRecordingRunningStatus() const; // start and stop by the epg running status
+	bool isPreTuning() const; // see preTune()
+	int getZapBufferCount() const; // channels of the transponder buffered for zapping (0 - 2)
+	int getTimeShiftBufferSize() const; // GiB, 0 = memory only
+	int getTimeShiftBufferDuration() const; // minutes, 0 = limited by the size
+	int getStreamServerPort() const; // see DvbStreamServer; 0 = disabled
 	void setRecordingFolder(const QString &path);
 	void setTimeShiftFolder(const QString &path);
+	void setTimeShiftBufferSize(int size); // GiB, 0 = memory only
+	void setTimeShiftBufferDuration(int duration); // minutes, 0 = limited by the size
 	void setXmltvFileName(const QString &path);
 	void setNamingFormat(const QString namingFormat);
 	void setRecordingRegex(const QString regex);
@@ -170,6 +191,7 @@ private slots:
 
 private:
 	void loadDeviceManager();
+	void cancelPreTuning(int index);
 
 	void readDeviceConfigs();
 	void updateSourceMapping();
@@ -185,6 +207,7 @@ private:
 	XmlTv *xmlTv;
 	DvbLiveView *liveView;
 	DvbRecordingModel *recordingModel;
+	DvbStreamServer *streamServer;
 	bool reacquireDevice;
 
 	QList<DvbDeviceConfig> deviceConfigs;
@@ -210,6 +233,7 @@ public:
 	QList<DvbConfig> configs;
 	int useCount; // -1 means exclusive use
 	int prioritizedUseCount;
+	bool preTuned; // acquired and tuned without a user (useCount is 0)
 	int numberOfTuners;
 	QString source;
 	DvbTransponder transponder;
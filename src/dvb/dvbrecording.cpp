@@ -21,24 +21,35 @@
 #include "../log.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <QCoreApplication>
 #include <QDataStream>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QEventLoop>
 #include <QMap>
+#include <QFileInfo>
 #include <QProcess>
+#include <QSaveFile>
 #include <QSet>
 #include <QStandardPaths>
+#include <QTimer>
 #include <QVariant>
+#include <algorithm>
 
 #include "../ensurenopendingoperation.h"
+#include "dvbconfig.h"
 #include "dvbdevice.h"
 #include "dvbepg.h"
 #include "dvbliveview.h"
 #include "dvbmanager.h"
 #include "dvbrecording.h"
 #include "dvbrecording_p.h"
+#include "dvbscan.h"
 #include "dvbtab.h"
 
 bool DvbRecording::validate()
@@ -58,17 +69,24 @@ bool DvbRecording::validate()
 }
 
 DvbRecordingModel::DvbRecordingModel(DvbManager *manager_, QObject *parent) : QObject(parent),
-	manager(manager_), hasPendingOperation(false)
+	manager(manager_), maxEpgDuration(0), hasPendingOperation(false),
+	recordingRegexesValid(false),
+	deferredEventPending(false), conflictCheckPending(false), duplicateCheckPending(false),
+	transitionTimerId(0), idleTimerId(0)
 {
 	sqlInit(QLatin1String("RecordingSchedule"),
 		QStringList() << QLatin1String("Name") << QLatin1String("Channel") << QLatin1String("Begin") <<
 		QLatin1String("Duration") << QLatin1String("Repeat") << QLatin1String("Subheading") << QLatin1String("Details")
-		<< QLatin1String("beginEPG") << QLatin1String("endEPG") << QLatin1String("durationEPG") << QLatin1String("Priority") << QLatin1String("Disabled"));
+		<< QLatin1String("beginEPG") << QLatin1String("endEPG") << QLatin1String("durationEPG") << QLatin1String("Priority") << QLatin1String("Disabled")
+		<< QLatin1String("Profile") << QLatin1String("AutoDisabled"));
 
-	// we regularly recheck the status of the recordings
-	// this way we can keep retrying if the device was busy / tuning failed
+	// the timer fires at the next start / stop of a recording; failed
+	// recordings are retried regularly (the device may be busy / tuning failed)
 
-	startTimer(5000);
+	armTransitionTimer();
+
+	// the channels are rescanned when the devices have been idle for a while
+	idleTimerId = startTimer(5 * 60 * 1000);
 
 	// compatibility code
 
@@ -135,6 +153,9 @@ DvbRecordingModel::~DvbRecordingModel()
 		qCWarning(logDvb, "Illegal recursive call");
 	}
 
+	// stopping the recordings finishes the mux captures; the resulting splitters
+	// are children of the model and get interrupted when they are deleted
+	recordingFiles.clear();
 	sqlFlush();
 }
 
@@ -197,8 +218,16 @@ DvbSharedRecording DvbRecordingModel::addRecording(DvbRecording &recording, bool
 
 	DvbSharedRecording newRecording(new DvbRecording(recording));
 	recordings.insert(*newRecording, newRecording);
+	indexRecording(newRecording);
+	scheduleTransition(newRecording);
+	armTransitionTimer();
 	sqlInsert(*newRecording);
 	emit recordingAdded(newRecording);
+
+	if (!newRecording->disabled) {
+		disableConflicts();
+	}
+
 	return newRecording;
 }
 
@@ -221,17 +250,35 @@ void DvbRecordingModel::updateRecording(DvbSharedRecording recording,
 	modifiedRecording.setSqlKey(*recording);
 
 	if (!updateStatus(modifiedRecording)) {
+		unindexRecording(recording);
 		recordings.remove(*recording);
 		recordingFiles.remove(*recording);
+		unscheduleTransition(recording);
+		armTransitionTimer();
 		sqlRemove(*recording);
 		emit recordingRemoved(recording);
 		return;
 	}
 
+	// a changed schedule may cause new conflicts or resolve old ones
+	bool rescheduled = ((modifiedRecording.channel != recording->channel) ||
+		(modifiedRecording.begin != recording->begin) ||
+		(modifiedRecording.end != recording->end) ||
+		(modifiedRecording.priority != recording->priority) ||
+		(recording->disabled && !modifiedRecording.disabled));
+
 	emit recordingAboutToBeUpdated(recording);
+	unindexRecording(recording);
 	*const_cast<DvbRecording *>(recording.constData()) = modifiedRecording;
+	indexRecording(recording);
+	scheduleTransition(recording);
+	armTransitionTimer();
 	sqlUpdate(*recording);
 	emit recordingUpdated(recording);
+
+	if (rescheduled) {
+		disableConflicts();
+	}
 }
 
 void DvbRecordingModel::removeRecording(DvbSharedRecording recording)
@@ -248,34 +295,35 @@ void DvbRecordingModel::removeRecording(DvbSharedRecording recording)
 		return;
 	}
 
-	recordings.remove(*recording);
-	recordingFiles.remove(*recording);
-	sqlRemove(*recording);
-	emit recordingRemoved(recording);
+	takeRecording(recording);
 	executeActionAfterRecording(*recording);
-	findNewRecordings();
 	removeDuplicates();
 	disableConflicts();
 }
 
-
-void DvbRecordingModel::disableLessImportant(DvbSharedRecording &recording1, DvbSharedRecording &recording2)
+void DvbRecordingModel::takeRecording(const DvbSharedRecording &recording)
 {
-	if (recording1->priority < recording2->priority) {
-		DvbRecording rec1 = *(recording1.constData());
-		rec1.disabled = true;
-		qCWarning(logDvb, "Disabled %s because %s has more priority", qPrintable(recording1->name), qPrintable(recording2->name));
-	}
-	if (recording2->priority < recording1->priority) {
-		DvbRecording rec2 = *(recording1.constData());
-		rec2.disabled = true;
-		qCWarning(logDvb, "Disabled %s because %s has more priority", qPrintable(recording2->name), qPrintable(recording1->name));
+	if (recordings.value(*recording) != recording) {
+		// already removed
+		return;
 	}
+
+	unindexRecording(recording);
+	recordings.remove(*recording);
+	recordingFiles.remove(*recording);
+	unscheduleTransition(recording);
+	armTransitionTimer();
+	sqlRemove(*recording);
+	emit recordingRemoved(recording);
+	requeueSimilarEntries(*recording);
 }
 
+
 void DvbRecordingModel::addToUnwantedRecordings(DvbSharedRecording recording)
 {
 	unwantedRecordings.append(recording);
+	unwantedSignatures.insert(DvbRecordingSignature(recording->channel, recording->begin,
+		recording->duration));
 	qCDebug(logDvb, "executed %s", qPrintable(recording->name));
 }
 
@@ -297,269 +345,645 @@ void DvbRecordingModel::executeActionAfterRecording(DvbRecording recording)
 
 void DvbRecordingModel::removeDuplicates()
 {
-	QList<DvbSharedRecording> recordingList = QList<DvbSharedRecording>();
-	DvbEpgModel *epgModel = manager->getEpgModel();
+	// the recordings can't be removed while another operation is in progress
+	duplicateCheckPending = true;
+	postDeferredEvent();
+}
 
-	if (!epgModel)
-		return;
+void DvbRecordingModel::takeDuplicates()
+{
+	EnsureNoPendingOperation ensureNoPendingOperation(hasPendingOperation);
+	QSet<DvbRecordingSignature> signatures;
+	QList<DvbSharedRecording> duplicates;
 
-	QMap<DvbSharedRecording, DvbSharedEpgEntry> recordingMap = epgModel->getRecordings();
-	foreach(DvbSharedRecording key, recordings.values())
-	{
-		recordingList.append(key);
-	}
-	int i = 0;
-	foreach(DvbSharedRecording rec1, recordingList)
-	{
-		int j = 0;
-		DvbRecording loopEntry1 = *rec1;
-		foreach(DvbSharedRecording rec2, recordingList)
-		{
-			DvbRecording loopEntry2 = *rec2;
-			if (i < j) {
-				if (loopEntry1.begin == loopEntry2.begin
-					&& loopEntry1.duration == loopEntry2.duration
-					&& loopEntry1.channel->name == loopEntry2.channel->name
-					&& loopEntry1.name == loopEntry2.name) {
-					recordings.remove(recordings.key(rec1));
-					recordingMap.remove(rec1);
-					qCDebug(logDvb, "Removed. %s", qPrintable(loopEntry1.name));
-				}
-			}
-			j = j + 1;
+	foreach (const DvbSharedRecording &recording, recordings) {
+		DvbRecordingSignature signature(recording->channel, recording->begin,
+			recording->duration, recording->name);
+
+		if (signatures.contains(signature)) {
+			duplicates.append(recording);
+		} else {
+			signatures.insert(signature);
 		}
-		i = i + 1;
 	}
-	epgModel->setRecordings(recordingMap);
+
+	// the epg model and the views are updated through recordingRemoved()
+	foreach (const DvbSharedRecording &recording, duplicates) {
+		takeRecording(recording);
+		qCDebug(logDvb, "Removed. %s", qPrintable(recording->name));
+	}
 
 	qCDebug(logDvb, "executed.");
 
 }
 
-bool DvbRecordingModel::existsSimilarRecording(DvbEpgEntry recording)
+bool DvbRecordingModel::existsSimilarRecording(const DvbEpgEntry &entry) const
 {
-	bool found = false;
-
-	DvbEpgEntry entry = recording;
-	DvbEpgModel *epgModel = manager->getEpgModel();
+	QDateTime begin = entry.begin.toUTC();
+	QDateTime end = begin.addSecs(QTime(0, 0, 0).secsTo(entry.duration));
+	QHash<DvbSharedChannel, QMultiMap<QDateTime, DvbSharedRecording> >::ConstIterator
+		channelIt = epgRecordings.constFind(entry.channel);
 
-	if (!epgModel)
-		return found;
+	if (channelIt != epgRecordings.constEnd()) {
+		// only recordings which begin at most 'maxEpgDuration' before the entry
+		// can include it
+		QMultiMap<QDateTime, DvbSharedRecording>::ConstIterator it =
+			channelIt->lowerBound(begin.addSecs(-maxEpgDuration));
 
-	QMap<DvbSharedRecording, DvbSharedEpgEntry> recordingMap = epgModel->getRecordings();
-	foreach(DvbSharedRecording key, recordingMap.keys())
-	{
-		DvbEpgEntry loopEntry = *(recordingMap.value(key));
-		int loopLength = 60 * 60 * loopEntry.duration.hour() + 60 * loopEntry.duration.minute() + loopEntry.duration.second();
-		int length = 60 * 60 * entry.duration.hour() + 60 * entry.duration.minute() + entry.duration.second();
-		QDateTime end = entry.begin.addSecs(length);
-		QDateTime loopEnd = loopEntry.begin.addSecs(loopLength);
+		for (; (it != channelIt->constEnd()) && (it.key() <= end); ++it) {
+			QDateTime recordingEnd = it.key().addSecs(
+				QTime(0, 0, 0).secsTo((*it)->durationEPG));
 
-		if (QString::compare(entry.channel->name, loopEntry.channel->name) == 0) {
 			// Is included in an existing recording
-			if (entry.begin <= loopEntry.begin && end >= loopEnd) {
-				found = true;
-				break;
+			if ((begin <= it.key()) && (end >= recordingEnd)) {
+				return true;
 			// Includes an existing recording
-			} else if (entry.begin >= loopEntry.begin && end <= loopEnd) {
-				found = true;
-				break;
+			} else if ((begin >= it.key()) && (end <= recordingEnd)) {
+				return true;
 			}
 		}
 	}
 
-	QList<DvbSharedRecording> unwantedRecordingsList = manager->getRecordingModel()->getUnwantedRecordings();
+	// unwanted recordings are compared including the margins
+	DvbRecordingSignature signature(entry.channel,
+		begin.addSecs(-manager->getBeginMargin()),
+		entry.duration.addSecs(manager->getBeginMargin() + manager->getEndMargin()));
 
-	foreach(DvbSharedRecording unwanted, unwantedRecordingsList)
-	{
-		DvbRecording loopEntry = *unwanted;
-		if (QString::compare(entry.begin.toString(), ((loopEntry.begin.addSecs(manager->getBeginMargin()))).toString()) == 0
-				&& QString::compare(entry.channel->name, loopEntry.channel->name) == 0
-				&& QString::compare((entry.duration).toString(),
-						loopEntry.duration.addSecs(- manager->getBeginMargin() - manager->getEndMargin()).toString()) == 0) {
-			qCDebug(logDvb, "Found from unwanteds %s", qPrintable(loopEntry.name));
-			found = true;
-			break;
-		}
+	if (unwantedSignatures.contains(signature)) {
+		qCDebug(logDvb, "Found from unwanteds %s", qPrintable(entry.title(FIRST_LANG)));
+		return true;
 	}
 
-	return found;
+	return false;
 }
 
-void DvbRecordingModel::disableConflicts()
+void DvbRecordingModel::indexRecording(const DvbSharedRecording &recording)
 {
-	int maxSize = 1; // manager->getDeviceConfigs().size();
-	// foreach(DvbDeviceConfig config, manager->getDeviceConfigs())
-	// {
-	//	maxSize = maxSize + config.numberOfTuners;
-	// }
+	if (!recording->beginEPG.isValid()) {
+		return;
+	}
 
-	QList<DvbSharedRecording> recordingList = QList<DvbSharedRecording>();
-	foreach(DvbSharedRecording rec, recordings.values())
-	{
-		if (!(rec->disabled)) {
-			recordingList.append(rec);
+	epgRecordings[recording->channel].insert(recording->beginEPG.toUTC(), recording);
+	maxEpgDuration = qMax(maxEpgDuration, QTime(0, 0, 0).secsTo(recording->durationEPG));
+}
+
+void DvbRecordingModel::unindexRecording(const DvbSharedRecording &recording)
+{
+	if (!recording->beginEPG.isValid()) {
+		return;
+	}
+
+	QHash<DvbSharedChannel, QMultiMap<QDateTime, DvbSharedRecording> >::Iterator it =
+		epgRecordings.find(recording->channel);
+
+	if (it != epgRecordings.end()) {
+		it->remove(recording->beginEPG.toUTC(), recording);
+
+		if (it->isEmpty()) {
+			epgRecordings.erase(it);
 		}
 	}
+}
 
-	foreach(DvbSharedRecording rec1, recordingList)
-	{
-		QList<DvbSharedRecording> conflictList = QList<DvbSharedRecording>();
-		conflictList.append(rec1);
+void DvbRecordingModel::disableConflicts()
+{
+	// updateRecording() can't be called recursively, so the check is done later
+	conflictCheckPending = true;
+	postDeferredEvent();
+}
 
-		foreach(DvbSharedRecording rec2, recordingList)
-		{
-			if (isInConflictWithAll(rec2, conflictList)) {
-				conflictList.append(rec2);
-				qCDebug(logDvb, "conflict: '%s' '%s' and '%s' '%s'", qPrintable(rec1->name), qPrintable(rec1->begin.toString()), qPrintable(rec2->name), qPrintable(rec2->begin.toString()));
+void DvbRecordingModel::resolveConflicts()
+{
+	QDateTime currentDateTime = QDateTime::currentDateTime().toUTC();
+	QList<DvbSharedRecording> recordingList;
 
-			}
+	// recordings which were disabled because of a conflict compete again,
+	// so that they are re-enabled once a tuner is available
 
-		}
-		if (conflictList.size() > maxSize) {
-			disableLeastImportants(conflictList);
+	foreach (const DvbSharedRecording &recording, recordings) {
+		if ((!recording->disabled || recording->autoDisabled) &&
+		    (recording->end > currentDateTime)) {
+			recordingList.append(recording);
 		}
 	}
 
+	DvbRecordingScheduler scheduler(manager->getDeviceConfigs());
+	QSet<DvbSharedRecording> conflicts = scheduler.findConflicts(recordingList).toSet();
+
+	foreach (const DvbSharedRecording &recording, recordingList) {
+		bool conflicting = conflicts.contains(recording);
+
+		if (recording->disabled == conflicting) {
+			continue;
+		}
+
+		DvbRecording modifiedRecording = *recording;
+		modifiedRecording.disabled = conflicting;
+		modifiedRecording.autoDisabled = conflicting;
+		qCDebug(logDvb, "%s: %s %s", conflicting ? "disabled" : "re-enabled",
+			qPrintable(modifiedRecording.name),
+			qPrintable(modifiedRecording.begin.toString()));
+		updateRecording(recording, modifiedRecording);
+	}
 }
 
+void DvbRecordingModel::invalidateRecordingRegexes()
+{
+	recordingRegexesValid = false;
+}
 
-bool DvbRecordingModel::areInConflict(DvbSharedRecording recording1, DvbSharedRecording recording2)
+/*
+ * Returns the longest word (case folded) which every title matching 'pattern' has to
+ * contain or an empty string if the pattern can't be analyzed. 'wordStart' is set if
+ * the word has to be at the beginning of a word of the title.
+ */
+static QString requiredRegexWord(const QString &pattern, bool &wordStart)
 {
-	int length1 = 60 * 60 * recording1->duration.hour() + 60 * recording1->duration.minute() + recording1->duration.second();
-	QDateTime end1 = recording1->begin.addSecs(length1);
-	int length2 = 60 * 60 * recording2->duration.hour() + 60 * recording2->duration.minute() + recording2->duration.second();
-	QDateTime end2 = recording2->begin.addSecs(length2);
-	if (!recording1->disabled && !recording1->disabled) {
-		if (recording1->channel->transportStreamId != recording2->channel->transportStreamId) {
-			if (recording2->begin > recording1->begin && recording2->begin < end1) {
-				return true;
+	static const QRegularExpression extendedSyntax(QLatin1String("\\(\\?[a-zA-Z^-]*x"));
+	wordStart = false;
+
+	// alternatives may make any part optional; whitespace is ignored in extended syntax
+	if (pattern.contains(QLatin1Char('|')) || pattern.contains(extendedSyntax)) {
+		return QString();
+	}
+
+	QString word;
+	QString current;
+	bool currentStart = false;
+	bool atBoundary = false; // a literal which follows begins a word of the title
+
+	for (int i = 0; i <= pattern.size(); ++i) {
+		QChar c = ((i < pattern.size()) ? pattern.at(i) : QChar());
+
+		if ((i < pattern.size()) && c.isLetterOrNumber()) {
+			if (current.isEmpty()) {
+				currentStart = atBoundary;
 			}
-			if (recording1->begin > recording2->begin && recording1->begin < end2) {
-				return true;
+
+			current.append(c);
+			continue;
+		}
+
+		// these quantifiers make the preceding character optional
+		if ((c == QLatin1Char('?')) || (c == QLatin1Char('*')) || (c == QLatin1Char('{'))) {
+			current.chop(1);
+		}
+
+		// a word at the beginning of a title word can be looked up faster
+		if (!current.isEmpty() && ((currentStart && !wordStart) ||
+		    ((currentStart == wordStart) && (current.size() > word.size())))) {
+			word = current;
+			wordStart = currentStart;
+		}
+
+		current.clear();
+
+		if (i == pattern.size()) {
+			break;
+		}
+
+		atBoundary = false;
+
+		switch (c.unicode()) {
+		case '^':
+			atBoundary = true;
+			break;
+		case '\\': {
+			QChar next = (((i + 1) < pattern.size()) ? pattern.at(i + 1) : QChar());
+			++i;
+
+			if (next == QLatin1Char('b')) {
+				atBoundary = true;
+			} else if (QString(QLatin1String("cgkopxENPQ")).contains(next)) {
+				// escapes which are followed by names or literal text
+				wordStart = false;
+				return QString();
+			} else if (!next.isNull() && !next.isLetterOrNumber()) {
+				// escaped literal which separates words
+				atBoundary = true;
+			}
+
+			break;
+		    }
+		case '(':
+		case '[':
+		case '{': {
+			// groups, character classes and counted quantifiers are skipped
+			int depth = 0;
+			bool inClass = false;
+
+			for (; i < pattern.size(); ++i) {
+				QChar d = pattern.at(i);
+
+				if (d == QLatin1Char('\\')) {
+					++i;
+				} else if (inClass) {
+					if ((d == QLatin1Char(']')) && (depth == 0)) {
+						break;
+					}
+
+					inClass = (d != QLatin1Char(']'));
+				} else if (d == QLatin1Char('[')) {
+					inClass = true;
+
+					// ']' is a literal at the beginning of a class
+					if (pattern.mid(i + 1, 1) == QLatin1String("^")) {
+						++i;
+					}
+
+					if (pattern.mid(i + 1, 1) == QLatin1String("]")) {
+						++i;
+					}
+				} else if ((d == QLatin1Char('(')) || (d == QLatin1Char('{'))) {
+					++depth;
+				} else if (((d == QLatin1Char(')')) || (d == QLatin1Char('}'))) &&
+					   (--depth <= 0)) {
+					break;
+				}
 			}
+
+			break;
+		    }
+		case '.':
+		case '$':
+		case '?':
+		case '*':
+		case '+':
+		case ')':
+			break;
+		default:
+			// literal which separates words
+			atBoundary = true;
+			break;
 		}
 	}
-	return false;
+
+	return word.toCaseFolded();
 }
-bool DvbRecordingModel::isInConflictWithAll(DvbSharedRecording rec, QList<DvbSharedRecording> recList)
+
+bool DvbRecordingModel::hasRecordingRegexes()
 {
+	if (recordingRegexesValid) {
+		return !recordingRegexes.isEmpty();
+	}
 
-	foreach(DvbSharedRecording listRec, recList)
-	{
-		if (!areInConflict(rec, listRec)) {
+	recordingRegexesValid = true;
+	recordingRegexes.clear();
+	recordingRegexPriorities.clear();
+	recordingRegexWords.clear();
+	recordingRegexWordStarts.clear();
+	combinedRecordingRegex = QRegularExpression();
+
+	QStringList regexList = manager->getRecordingRegexList();
+	QList<int> priorityList = manager->getRecordingRegexPriorityList();
+	QStringList patterns;
+
+	for (int i = 0; i < regexList.size(); ++i) {
+		const QString &pattern = regexList.at(i);
+
+		if (pattern.isEmpty()) {
+			continue;
+		}
+
+		QRegularExpression recordingRegex(pattern);
+
+		if (!recordingRegex.isValid()) {
+			qCWarning(logDvb, "Invalid recording regex %s: %s", qPrintable(pattern),
+				qPrintable(recordingRegex.errorString()));
+			continue;
+		}
+
+		recordingRegex.optimize();
+		recordingRegexes.append(recordingRegex);
+		recordingRegexPriorities.append(priorityList.value(i));
+		bool wordStart;
+		recordingRegexWords.append(requiredRegexWord(pattern, wordStart));
+		recordingRegexWordStarts.append(wordStart);
+		patterns.append(QLatin1String("(?:") + pattern + QLatin1Char(')'));
+	}
+
+	if (patterns.size() > 1) {
+		// branch reset group: the capture groups of every alternative are numbered
+		// from one, so back references still work
+		combinedRecordingRegex = QRegularExpression(QLatin1String("(?|") +
+			patterns.join(QLatin1Char('|')) + QLatin1Char(')'));
+
+		if (combinedRecordingRegex.isValid()) {
+			combinedRecordingRegex.optimize();
+		} else {
+			combinedRecordingRegex = QRegularExpression();
+		}
+	}
+
+	return !recordingRegexes.isEmpty();
+}
+
+/*
+ * Looks up the entries which contain the words required by the recording regexes in the
+ * epg text index. Returns false if a regex doesn't require a word (all entries have to be
+ * matched then).
+ */
+bool DvbRecordingModel::findRegexCandidates(QSet<DvbSharedEpgEntry> &candidates) const
+{
+	DvbEpgModel *epgModel = manager->getEpgModel();
+
+	for (int i = 0; i < recordingRegexWords.size(); ++i) {
+		const QString &word = recordingRegexWords.at(i);
+
+		if (word.isEmpty()) {
 			return false;
 		}
+
+		QList<DvbSharedEpgEntry> entries = recordingRegexWordStarts.at(i) ?
+			epgModel->findEntries(QStringList(word)) :
+			epgModel->findEntriesContaining(word);
+
+		foreach (const DvbSharedEpgEntry &entry, entries) {
+			candidates.insert(entry);
+		}
 	}
 
 	return true;
 }
 
-int DvbRecordingModel::getNumberOfLeastImportants(QList<DvbSharedRecording> recList)
+/*
+ * Returns the index of the first matching regex or -1.
+ */
+int DvbRecordingModel::findRecordingRegex(const QString &title) const
 {
-	DvbSharedRecording leastImportantShared = getLeastImportant(recList);
-	int leastImportance = leastImportantShared->priority;
-	int count = 0;
-	foreach(DvbSharedRecording listRecShared, recList)
-	{
-		if (listRecShared->priority == leastImportance) {
-			count = count + 1;
+	if (!combinedRecordingRegex.pattern().isEmpty() &&
+	    !combinedRecordingRegex.match(title).hasMatch()) {
+		return -1;
+	}
+
+	for (int i = 0; i < recordingRegexes.size(); ++i) {
+		if (recordingRegexes.at(i).match(title).hasMatch()) {
+			return i;
 		}
 	}
 
-	return count;
+	return -1;
 }
 
-DvbSharedRecording DvbRecordingModel::getLeastImportant(QList<DvbSharedRecording> recList)
+void DvbRecordingModel::scheduleIfMatching(const DvbSharedEpgEntry &entry)
 {
-	DvbSharedRecording leastImportant = recList.value(0);
-	foreach(DvbSharedRecording listRec, recList)
-	{
-		qCDebug(logDvb, "name and priority %s %d", qPrintable(listRec->name), listRec->priority);
-		if (listRec->priority < leastImportant->priority) {
-			leastImportant = listRec;
-		}
+	if (entry->recording.isValid()) {
+		return;
 	}
 
-	qCDebug(logDvb, "least important: %s", qPrintable(leastImportant->name));
-	return leastImportant;
+	QString title = entry->title(FIRST_LANG);
+	int index = findRecordingRegex(title);
+
+	if ((index >= 0) && !existsSimilarRecording(*entry)) {
+		manager->getEpgModel()->scheduleProgram(entry, manager->getBeginMargin(),
+			manager->getEndMargin(), false, recordingRegexPriorities.at(index));
+		qCDebug(logDvb, "scheduled %s", qPrintable(title));
+	}
 }
 
-void DvbRecordingModel::disableLeastImportants(QList<DvbSharedRecording> recList)
+void DvbRecordingModel::requeueSimilarEntries(const DvbRecording &recording)
 {
-	int numberOfLeastImportants = getNumberOfLeastImportants(recList);
-	if (numberOfLeastImportants < recList.size()) {
-		DvbSharedRecording leastImportantShared = getLeastImportant(recList);
-		int leastImportance = leastImportantShared->priority;
+	DvbEpgModel *epgModel = manager->getEpgModel();
 
-		foreach(DvbSharedRecording listRecShared, recList)
-		{
-			DvbRecording listRec = *(listRecShared.constData());
-			if (listRecShared->priority == leastImportance) {
-				listRec.disabled = true;
-				updateRecording(listRecShared, listRec);
-				qCDebug(logDvb, "disabled: %s %s", qPrintable(listRec.name), qPrintable(listRec.begin.toString()));
-			}
+	if ((epgModel == NULL) || !recording.beginEPG.isValid() || !hasRecordingRegexes()) {
+		return;
+	}
+
+	// existsSimilarRecording() only rejects entries which overlap the recording
+	QDateTime begin = recording.beginEPG.toUTC();
+	QDateTime end = begin.addSecs(QTime(0, 0, 0).secsTo(recording.durationEPG));
+	DvbEpgEntryRange range = epgModel->getChannelEntries(recording.channel, begin, end);
+
+	for (DvbEpgEntryRange::ConstIterator it = range.constBegin(); it != range.constEnd(); ++it) {
+		const DvbSharedEpgEntry &entry = *it;
+
+		// the entry of the recording itself may have been unscheduled on purpose
+		if ((entry->begin.toUTC() == begin) && (entry->duration == recording.durationEPG)) {
+			continue;
+		}
+
+		if (!entry->recording.isValid() && (findRecordingRegex(entry->title(FIRST_LANG)) >= 0)) {
+			pendingEpgEntries.insert(entry);
 		}
 	}
 
+	if (!pendingEpgEntries.isEmpty()) {
+		postDeferredEvent();
+	}
+}
+
+static bool epgEntryBeginLessThan(const DvbSharedEpgEntry &x, const DvbSharedEpgEntry &y)
+{
+	if (x->begin != y->begin) {
+		return (x->begin < y->begin);
+	}
+
+	return (x->channel->name < y->channel->name);
 }
 
 void DvbRecordingModel::findNewRecordings()
 {
 	DvbEpgModel *epgModel = manager->getEpgModel();
 
-	if (!epgModel)
+	if (!epgModel || !hasRecordingRegexes())
 		return;
 
-	QMap<DvbEpgEntryId, DvbSharedEpgEntry> epgMap = epgModel->getEntries();
-	foreach(DvbEpgEntryId key, epgMap.keys())
-	{
-		DvbEpgEntry entry = *(epgMap.value(key));
-		QString title = entry.title(FIRST_LANG);
-		QStringList regexList = manager->getRecordingRegexList();
-		int i = 0;
-		foreach(QString regex, regexList) {
-			QRegExp recordingRegex = QRegExp(regex);
-			if (!recordingRegex.isEmpty())
-				{
-				if (recordingRegex.indexIn(title) != -1)
-				{
-					if (!DvbRecordingModel::existsSimilarRecording(*epgMap.value(key)))
-					{
-					int priority = manager->getRecordingRegexPriorityList().value(i);
-					epgModel->scheduleProgram(epgMap.value(key), manager->getBeginMargin(),
-							manager->getEndMargin(), false, priority);
-					qCDebug(logDvb, "scheduled %s", qPrintable(title));
-					}
-				}
+	QDateTime currentDateTime = QDateTime::currentDateTime().toUTC();
+	QSet<DvbSharedEpgEntry> candidates;
+
+	if (findRegexCandidates(candidates)) {
+		// the earlier entries are scheduled first (the later ones may be repetitions)
+		QList<DvbSharedEpgEntry> entries = candidates.toList();
+		std::sort(entries.begin(), entries.end(), epgEntryBeginLessThan);
+
+		foreach (const DvbSharedEpgEntry &entry, entries) {
+			if (entry->begin.addSecs(QTime(0, 0, 0).secsTo(entry->duration)) >
+			    currentDateTime) {
+				scheduleIfMatching(entry);
 			}
-			i = i + 1;
+		}
+
+		qCDebug(logDvb, "executed.");
+		return;
+	}
+
+	foreach (const DvbSharedChannel &channel, epgModel->getEpgChannels().keys()) {
+		// scheduleProgram() doesn't add or remove epg entries
+		DvbEpgEntryRange range = epgModel->getChannelEntries(channel, currentDateTime);
+
+		for (DvbEpgEntryRange::ConstIterator it = range.constBegin();
+		     it != range.constEnd(); ++it) {
+			scheduleIfMatching(*it);
 		}
 	}
 
 	qCDebug(logDvb, "executed.");
 }
 
-void DvbRecordingModel::timerEvent(QTimerEvent *event)
+void DvbRecordingModel::epgEntryChanged(const DvbSharedEpgEntry &entry)
+{
+	// the epg model doesn't allow recursive calls, so the entry is matched later
+
+	if (entry->recording.isValid() || !hasRecordingRegexes()) {
+		return;
+	}
+
+	pendingEpgEntries.insert(entry);
+	postDeferredEvent();
+}
+
+void DvbRecordingModel::epgEntryRemoved(const DvbSharedEpgEntry &entry)
+{
+	pendingEpgEntries.remove(entry);
+}
+
+void DvbRecordingModel::postDeferredEvent()
+{
+	if (!deferredEventPending) {
+		deferredEventPending = true;
+		QCoreApplication::postEvent(this, new QEvent(QEvent::User), Qt::LowEventPriority);
+	}
+}
+
+void DvbRecordingModel::customEvent(QEvent *event)
 {
 	Q_UNUSED(event)
+	deferredEventPending = false;
+	QSet<DvbSharedEpgEntry> epgEntries = pendingEpgEntries;
+	pendingEpgEntries.clear();
+
+	if (!epgEntries.isEmpty() && hasRecordingRegexes()) {
+		QDateTime currentDateTime = QDateTime::currentDateTime().toUTC();
+		// only the entries with the words required by the regexes are matched
+		QSet<DvbSharedEpgEntry> candidates;
+		bool indexed = findRegexCandidates(candidates);
+
+		foreach (const DvbSharedEpgEntry &entry, epgEntries) {
+			if (indexed && !candidates.contains(entry)) {
+				continue;
+			}
+
+			if (entry->begin.addSecs(QTime(0, 0, 0).secsTo(entry->duration)) >
+			    currentDateTime) {
+				scheduleIfMatching(entry);
+			}
+		}
+	}
+
+	if (duplicateCheckPending) {
+		duplicateCheckPending = false;
+		takeDuplicates();
+	}
+
+	// newly scheduled recordings may conflict as well
+	if (conflictCheckPending) {
+		conflictCheckPending = false;
+		resolveConflicts();
+	}
+}
+
+void DvbRecordingModel::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() == idleTimerId) {
+		scanChannels();
+		return;
+	}
+
+	killTimer(transitionTimerId);
+	transitionTimerId = 0;
 	QDateTime currentDateTime = QDateTime::currentDateTime().toUTC();
+	QList<DvbSharedRecording> stoppingRecordings;
+	QList<DvbSharedRecording> startingRecordings;
+
+	while (!transitions.isEmpty() && (transitions.constBegin().key() <= currentDateTime)) {
+		DvbSharedRecording recording = transitions.constBegin().value();
+		unscheduleTransition(recording);
 
-	foreach (const DvbSharedRecording &recording, recordings) {
 		if (recording->end <= currentDateTime) {
-			DvbRecording modifiedRecording = *recording;
-			updateRecording(recording, modifiedRecording);
+			QExplicitlySharedDataPointer<DvbRecordingFile> recordingFile =
+				recordingFiles.value(*recording);
+
+			if ((recordingFile.constData() != NULL) && recordingFile->isEventRunning() &&
+			    (recording->end.secsTo(currentDateTime) < (2 * 3600))) {
+				// the event overruns; check again later (at most two hours)
+				QDateTime transition = currentDateTime.addSecs(60);
+				transitions.insert(transition, recording);
+				transitionTimes.insert(recording, transition);
+				continue;
+			}
+
+			stoppingRecordings.append(recording);
+		} else {
+			startingRecordings.append(recording);
 		}
 	}
 
-	foreach (const DvbSharedRecording &recording, recordings) {
-		if ((recording->status != DvbRecording::Recording) &&
-		    (recording->begin <= currentDateTime)) {
+	// stop recordings first, so that their devices can be reused
+
+	foreach (const DvbSharedRecording &recording, stoppingRecordings + startingRecordings) {
+		if (recordings.value(*recording) == recording) {
 			DvbRecording modifiedRecording = *recording;
 			updateRecording(recording, modifiedRecording);
 		}
 	}
+
+	if (!stoppingRecordings.isEmpty()) {
+		// a stopped recording may free a tuner or leave a duplicate behind
+		removeDuplicates();
+		disableConflicts();
+	}
+
+	armTransitionTimer();
+}
+
+void DvbRecordingModel::scheduleTransition(const DvbSharedRecording &recording)
+{
+	unscheduleTransition(recording);
+	QDateTime transition;
+
+	switch (recording->status) {
+	case DvbRecording::Inactive:
+		transition = recording->begin;
+		break;
+	case DvbRecording::Recording:
+		transition = recording->end;
+		break;
+	case DvbRecording::Error:
+		transition = qMin(QDateTime::currentDateTime().toUTC().addSecs(5), recording->end);
+		break;
+	}
+
+	transitions.insert(transition, recording);
+	transitionTimes.insert(recording, transition);
+}
+
+void DvbRecordingModel::unscheduleTransition(const DvbSharedRecording &recording)
+{
+	QHash<DvbSharedRecording, QDateTime>::Iterator it = transitionTimes.find(recording);
+
+	if (it != transitionTimes.end()) {
+		transitions.remove(*it, recording);
+		transitionTimes.erase(it);
+	}
+}
+
+void DvbRecordingModel::armTransitionTimer()
+{
+	if (transitionTimerId != 0) {
+		killTimer(transitionTimerId);
+		transitionTimerId = 0;
+	}
+
+	if (transitions.isEmpty()) {
+		return;
+	}
+
+	// the wall clock may jump (suspend, time adjustments), so the timer
+	// is never armed for more than a minute
+
+	qint64 msecs = QDateTime::currentDateTime().toUTC().msecsTo(
+		transitions.constBegin().key());
+	transitionTimerId = startTimer(int(qBound<qint64>(0, msecs, 60000)));
 }
 
 void DvbRecordingModel::bindToSqlQuery(SqlKey sqlKey, QSqlQuery &query, int index) const
@@ -583,6 +1007,8 @@ void DvbRecordingModel::bindToSqlQuery(SqlKey sqlKey, QSqlQuery &query, int inde
 	query.bindValue(index++, recording->durationEPG.toString(Qt::ISODate));
 	query.bindValue(index++, recording->priority);
 	query.bindValue(index++, recording->disabled);
+	query.bindValue(index++, recording->profile);
+	query.bindValue(index++, recording->autoDisabled);
 }
 
 bool DvbRecordingModel::insertFromSqlQuery(SqlKey sqlKey, const QSqlQuery &query, int index)
@@ -605,20 +1031,60 @@ bool DvbRecordingModel::insertFromSqlQuery(SqlKey sqlKey, const QSqlQuery &query
 	recording->durationEPG = QTime::fromString(query.value(index++).toString(), Qt::ISODate);
 	recording->priority = query.value(index++).toInt();
 	recording->disabled = query.value(index++).toBool();
+	recording->profile = query.value(index++).toString();
+	recording->autoDisabled = query.value(index++).toBool();
 
 	if (recording->validate()) {
 		recording->setSqlKey(sqlKey);
 		recordings.insert(*newRecording, newRecording);
+		indexRecording(newRecording);
+		scheduleTransition(newRecording);
 		return true;
 	}
 
 	return false;
 }
 
+void DvbRecordingModel::updateRunningStatus(const DvbSharedChannel &channel, int eventId,
+	const QDateTime &begin, int runningStatus, bool present)
+{
+	foreach (const QExplicitlySharedDataPointer<DvbRecordingFile> &recordingFile,
+		 recordingFiles) {
+		recordingFile->updateRunningStatus(channel, eventId, begin, runningStatus, present);
+	}
+}
+
 /*
  * Returns -1 if no upcoming recordings.
  */
-int DvbRecordingModel::getSecondsUntilNextRecording() const
+QExplicitlySharedDataPointer<DvbMuxCapture> DvbRecordingModel::getMuxCapture(
+	const DvbSharedChannel &channel)
+{
+	for (int i = 0; i < muxCaptures.size(); ++i) {
+		DvbMuxCapture *muxCapture = muxCaptures.at(i);
+
+		if (muxCapture == NULL) {
+			muxCaptures.removeAt(i);
+			--i;
+			continue;
+		}
+
+		if (muxCapture->matches(channel)) {
+			return QExplicitlySharedDataPointer<DvbMuxCapture>(muxCapture);
+		}
+	}
+
+	QExplicitlySharedDataPointer<DvbMuxCapture> muxCapture(new DvbMuxCapture(manager, channel));
+
+	if (!muxCapture->isValid()) {
+		return QExplicitlySharedDataPointer<DvbMuxCapture>();
+	}
+
+	muxCaptures.append(muxCapture.data());
+	return muxCapture;
+}
+
+int DvbRecordingModel::getSecondsUntilNextRecording() const
 {
 	signed long timeUntil = -1;
 	foreach (const DvbSharedRecording &recording, recordings) {
@@ -652,49 +1118,47 @@ bool DvbRecordingModel::isScanWhenIdle() const
 
 bool DvbRecordingModel::shouldWeScanChannels() const
 {
-	int numberOfChannels = manager->getChannelModel()->getChannels().size();
-	int idleTime = 1000 * 3600 + 1; // TODO
-	if (idleTime > 1000 * 3600) {
-		if (DvbRecordingModel::getSecondsUntilNextRecording() > numberOfChannels * 10) {
-			if (DvbRecordingModel::isScanWhenIdle()) {
-				qCDebug(logDvb, "Scan on Idle enabled");
-				return true;
-			}
-		}
+	if (!isScanWhenIdle() || !idleSince.isValid()) {
+		return false;
 	}
 
-	return false;
-}
+	// idle for an hour and at most one rescan every six hours
+	QDateTime currentDateTime = QDateTime::currentDateTime().toUTC();
 
-void delay(int seconds)
-{
-	QTime dieTime= QTime::currentTime().addSecs(seconds);
-	while (QTime::currentTime() < dieTime)
-		QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+	if ((idleSince.secsTo(currentDateTime) < 3600) ||
+	    (lastIdleScan.isValid() && (lastIdleScan.secsTo(currentDateTime) < (6 * 3600)))) {
+		return false;
+	}
+
+	// the scan shouldn't delay the next recording (about ten seconds per channel)
+	int numberOfChannels = manager->getChannelModel()->getChannels().size();
+	int secondsUntilNextRecording = getSecondsUntilNextRecording();
 
-	qCInfo(logDvb, "Delayed for %d seconds", seconds);
+	return ((secondsUntilNextRecording < 0) ||
+		(secondsUntilNextRecording > (numberOfChannels * 10)));
 }
 
 void DvbRecordingModel::scanChannels()
 {
-	qCDebug(logDvb, "auto-scan channels");
+	// a live view (which may pre-tune devices) or a recording needs the devices;
+	// the incremental scan requests an exclusive device, which cancels pre-tuning
+	if (manager->getLiveView()->getChannel().isValid() || hasActiveRecordings()) {
+		idleSince = QDateTime();
+		return;
+	}
 
-	if (shouldWeScanChannels()) {
-		DvbChannelModel *channelModel = manager->getChannelModel();
-		QMap<int, DvbSharedChannel> channelMap = channelModel->getChannels();
-		foreach (int channelInt, channelMap.keys()) {
-			DvbSharedChannel channel;
+	QDateTime currentDateTime = QDateTime::currentDateTime().toUTC();
 
-			if (channelInt > 0) {
-				channel = channelModel->findChannelByNumber(channelInt);
-			}
-			if (channel.isValid()) {
-				// TODO update tab
-				qCDebug(logDvb, "Executed %s", qPrintable(channel->name));
-				manager->getLiveView()->playChannel(channel);
-				delay(5);
-			}
-		}
+	if (!idleSince.isValid()) {
+		idleSince = currentDateTime;
+	}
+
+	// only the transponders whose tables have changed are read completely
+	if (shouldWeScanChannels() && (findChild<DvbIncrementalScan *>() == NULL)) {
+		qCDebug(logDvb, "auto-scan channels");
+		lastIdleScan = currentDateTime;
+		DvbIncrementalScan *incrementalScan = new DvbIncrementalScan(manager, this);
+		incrementalScan->start();
 	}
 }
 
@@ -757,315 +1221,1706 @@ bool DvbRecordingModel::updateStatus(DvbRecording &recording)
 	return true;
 }
 
-DvbRecordingFile::DvbRecordingFile(DvbManager *manager_) : manager(manager_), device(NULL),
-	pmtValid(false)
+DvbRecordingWriter::DvbRecordingWriter() : closing(false), writtenBytes(0), fd(-1),
+	directIoRequested(false), directIo(false), dropCache(false), offset(0), advisedOffset(0),
+	syncedOffset(0), allocatedSize(0), preallocationFailed(false), droppedBuffers(0),
+	writtenBuffers(0), maxQueueDepth(0), totalLatency(0), maxLatency(0)
 {
-	connect(&pmtFilter, SIGNAL(pmtSectionChanged(QByteArray)),
-		this, SLOT(pmtSectionChanged(QByteArray)));
-	connect(&patPmtTimer, SIGNAL(timeout()), this, SLOT(insertPatPmt()));
+	currentBuffer.data = NULL;
+	currentBuffer.size = 0;
+	currentBuffer.fd = -1;
 }
 
-DvbRecordingFile::~DvbRecordingFile()
+DvbRecordingWriter::~DvbRecordingWriter()
 {
-	stop();
+	close();
+
+	foreach (const Buffer &buffer, freeBuffers) {
+		free(buffer.data);
+	}
 }
 
-bool DvbRecordingFile::start(DvbRecording &recording)
+void DvbRecordingWriter::open(int fd_, const QString &fileName_, const QDateTime &end_,
+	bool directIo_, bool dropCache_)
 {
-	if (recording.disabled) {
-		return false;
+	close();
+
+	int newFd = dup(fd_);
+
+	if (newFd < 0) {
+		qCWarning(logDvb, "Cannot duplicate the file descriptor of %s. Error: %d",
+			qPrintable(fileName_), errno);
+		return;
 	}
 
-	if (!file.isOpen()) {
-		QString folder = manager->getRecordingFolder();
-		QDate currentDate = QDate::currentDate();
-		QTime currentTime = QTime::currentTime();
+	end = end_;
+	directIoRequested = directIo_;
+	dropCache = dropCache_;
+	closing = false;
+	finishedFileCount.storeRelease(0);
+	currentFileName = fileName_;
+	writtenBytes = 0;
 
-		QString filename = manager->getNamingFormat();
-		filename = filename.replace("%year", currentDate.toString("yyyy"));
-		filename = filename.replace("%month", currentDate.toString("MM"));
-		filename = filename.replace("%day", currentDate.toString("dd"));
-		filename = filename.replace("%hour", currentTime.toString("hh"));
-		filename = filename.replace("%min", currentTime.toString("mm"));
-		filename = filename.replace("%sec", currentTime.toString("ss"));
-		filename = filename.replace("%channel", recording.channel->name);
-		filename = filename.replace("%title", QString(recording.name));
-		filename = filename.replace(QLatin1Char('/'), QLatin1Char('_'));
-		if (filename.isEmpty()) {
-			filename = QString(recording.name);
-		}
+	// the thread isn't running yet
+	startFile(newFd, fileName_);
 
-		QString path = folder + QLatin1Char('/') + filename;
+	mutex.lock();
+	currentBuffer = allocateBuffer();
+	mutex.unlock();
 
+	start();
+}
 
-		for (int attempt = 0; attempt < 100; ++attempt) {
-			if (attempt == 0) {
-				file.setFileName(path + QLatin1String(".m2t"));
-				recording.filename = filename + QLatin1String(".m2t");
-			} else {
-				file.setFileName(path + QLatin1Char('-') + QString::number(attempt) +
-					QLatin1String(".m2t"));
-				recording.filename = filename + QLatin1Char('-') + QString::number(attempt) +
-					QLatin1String(".m2t");
-			}
+void DvbRecordingWriter::switchFile(int fd_, const QString &fileName_)
+{
+	if (currentBuffer.data == NULL) {
+		return;
+	}
 
-			if (file.exists()) {
-				continue;
-			}
+	int newFd = dup(fd_);
 
-			if (file.open(QIODevice::WriteOnly)) {
-				break;
-			} else {
-				qCWarning(logDvb, "Cannot open file %s. Error: %d", qPrintable(file.fileName()), errno);
-			}
+	if (newFd < 0) {
+		qCWarning(logDvb, "Cannot duplicate the file descriptor of %s. Error: %d",
+			qPrintable(fileName_), errno);
+		return;
+	}
 
-			if ((attempt == 0) && !QDir(folder).exists()) {
-				if (QDir().mkpath(folder)) {
-					attempt = -1;
-					continue;
-				} else {
-					qCWarning(logDvb, "Cannot create folder %s", qPrintable(folder));
-				}
-			}
+	Buffer switchBuffer;
+	switchBuffer.data = NULL;
+	switchBuffer.size = 0;
+	switchBuffer.fd = newFd;
+	switchBuffer.fileName = fileName_;
 
-			if (folder != QDir::homePath()) {
-				folder = QDir::homePath();
-				path = folder + QLatin1Char('/') +
-					QString(recording.name).replace(QLatin1Char('/'), QLatin1Char('_'));
-				attempt = -1;
-				continue;
-			}
+	QMutexLocker locker(&mutex);
+
+	if (currentBuffer.size > 0) {
+		queuedBuffers.append(currentBuffer);
+		currentBuffer = allocateBuffer();
+	}
+
+	// never dropped (even if the queue is full)
+	queuedBuffers.append(switchBuffer);
+	bufferQueued.wakeOne();
+	currentFileName = fileName_;
+	writtenBytes = 0;
+}
+
+void DvbRecordingWriter::write(const char *data, int size)
+{
+	if (currentBuffer.data == NULL) {
+		return;
+	}
+
+	Q_ASSERT((size % 188) == 0);
 
+	while (size > 0) {
+		int bytes = qMin(size, int(BufferSize) - currentBuffer.size);
+		memcpy(currentBuffer.data + currentBuffer.size, data, bytes);
+		currentBuffer.size += bytes;
+		writtenBytes += bytes;
+		data += bytes;
+		size -= bytes;
+
+		if (currentBuffer.size < BufferSize) {
 			break;
 		}
 
-		if (manager->createInfoFile()) {
-			QString infoFile = path + ".txt";
-			QFile file(infoFile);
-			if (file.open(QIODevice::ReadWrite))
-			{
-			    QTextStream stream(&file);
-			    stream << "EPG info" << endl;
-			    stream << "Title: " + QString(recording.name) << endl;
-			    stream << "Description: " + QString(recording.subheading) << endl;
-			    //stream << "Details: " + QString(recording.details) << endl; // Details is almost always empty
-			    stream << "Channel: " + QString(recording.channel->name) << endl;
-			    stream << "Date: " + recording.beginEPG.toLocalTime().toString("yyyy-MM-dd") << endl;
-			    stream << "Start time: " + recording.beginEPG.toLocalTime().toString("hh:mm:ss") << endl;
-			    stream << "Duration: " + recording.durationEPG.toString("HH:mm:ss") << endl;
+		QMutexLocker locker(&mutex);
+
+		if (queuedBuffers.size() >= MaxQueuedBuffers) {
+			// the disk can't keep up; blocking would stall all devices
+			if (droppedBuffers == 0) {
+				qCWarning(logDvb, "Disk too slow, dropping data of %s",
+					qPrintable(currentFileName));
 			}
-		}
 
-		if (!file.isOpen()) {
-			qCWarning(logDvb, "Cannot open file %s", qPrintable(file.fileName()));
-			return false;
+			// the buffer only contains whole packets, so the file stays aligned;
+			// position() continues at the offset where the dropped data would start
+			++droppedBuffers;
+			writtenBytes -= currentBuffer.size;
+			currentBuffer.size = 0;
+			continue;
 		}
-	}
 
-	if (device == NULL) {
-		channel = recording.channel;
-		device = manager->requestDevice(channel->source, channel->transponder,
-			DvbManager::Prioritized);
+		queuedBuffers.append(currentBuffer);
 
-		if (device == NULL) {
-			qCWarning(logDvb, "Cannot find a suitable device");
-			return false;
+		if (queuedBuffers.size() > maxQueueDepth) {
+			maxQueueDepth = queuedBuffers.size();
 		}
 
-		/*
-		 * When there's not enough devices to record while
-		 * watching, switch to the channel that will be recorded
-		 */
-		if (manager->hasReacquired())
-			manager->getLiveView()->playChannel(channel);
+		bufferQueued.wakeOne();
+		currentBuffer = allocateBuffer();
+	}
+}
 
-		connect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
-		pmtFilter.setProgramNumber(channel->serviceId);
-		device->addSectionFilter(channel->pmtPid, &pmtFilter);
-		pmtSectionData = channel->pmtSectionData;
-		patGenerator.initPat(channel->transportStreamId, channel->serviceId,
-			channel->pmtPid);
+void DvbRecordingWriter::close()
+{
+	if (currentBuffer.data == NULL) {
+		return;
+	}
 
-		if (channel->isScrambled && !pmtSectionData.isEmpty()) {
-			device->startDescrambling(pmtSectionData, this);
-		}
+	mutex.lock();
+
+	if (currentBuffer.size > 0) {
+		queuedBuffers.append(currentBuffer);
+	} else {
+		freeBuffers.append(currentBuffer);
 	}
 
-	manager->getRecordingModel()->setCurrentRecording(recording);
+	currentBuffer.data = NULL;
+	currentBuffer.size = 0;
+	closing = true;
+	bufferQueued.wakeOne();
+	mutex.unlock();
 
-	return true;
+	// the thread completes the last file
+	wait();
+
+	// keep one buffer for the next recording
+	while (freeBuffers.size() > 1) {
+		free(freeBuffers.takeLast().data);
+	}
 }
 
-void DvbRecordingFile::stop()
+DvbRecordingWriter::Buffer DvbRecordingWriter::allocateBuffer()
 {
-	if (device != NULL) {
-		if (channel->isScrambled && !pmtSectionData.isEmpty()) {
-			device->stopDescrambling(pmtSectionData, this);
-		}
+	if (!freeBuffers.isEmpty()) {
+		Buffer buffer = freeBuffers.takeLast();
+		buffer.size = 0;
+		return buffer;
+	}
 
-		foreach (int pid, pids) {
-			device->removePidFilter(pid, this);
-		}
+	Buffer buffer;
+	void *data = NULL;
 
-		device->removeSectionFilter(channel->pmtPid, &pmtFilter);
-		disconnect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
-		manager->releaseDevice(device, DvbManager::Prioritized);
-		device = NULL;
+	if (posix_memalign(&data, BufferAlignment, BufferSize) != 0) {
+		qFatal("Cannot allocate memory");
 	}
 
-	pmtValid = false;
-	patPmtTimer.stop();
-	patGenerator.reset();
-	pmtGenerator.reset();
-	pmtSectionData.clear();
-	pids.clear();
-	buffers.clear();
-	file.close();
-	channel = DvbSharedChannel();
-
-	manager->getRecordingModel()->executeActionAfterRecording(manager->getRecordingModel()->getCurrentRecording());
-	manager->getRecordingModel()->findNewRecordings();
-	manager->getRecordingModel()->removeDuplicates();
-	manager->getRecordingModel()->disableConflicts();
+	buffer.data = static_cast<char *>(data);
+	buffer.size = 0;
+	buffer.fd = -1;
+	return buffer;
 }
 
-void DvbRecordingFile::deviceStateChanged()
+void DvbRecordingWriter::run()
 {
-	if (device->getDeviceState() == DvbDevice::DeviceReleased) {
-		foreach (int pid, pids) {
-			device->removePidFilter(pid, this);
-		}
+	while (true) {
+		mutex.lock();
 
-		device->removeSectionFilter(channel->pmtPid, &pmtFilter);
-		disconnect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+		while (queuedBuffers.isEmpty() && !closing) {
+			bufferQueued.wait(&mutex);
+		}
 
-		if (channel->isScrambled && !pmtSectionData.isEmpty()) {
-			device->stopDescrambling(pmtSectionData, this);
+		if (queuedBuffers.isEmpty()) {
+			mutex.unlock();
+			break;
 		}
 
-		device = manager->requestDevice(channel->source, channel->transponder,
-			DvbManager::Prioritized);
+		Buffer buffer = queuedBuffers.takeFirst();
+		mutex.unlock();
 
-		if (device != NULL) {
-			connect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
-			device->addSectionFilter(channel->pmtPid, &pmtFilter);
+		if (buffer.data == NULL) {
+			finishFile();
+			startFile(buffer.fd, buffer.fileName);
+			finishedFileCount.ref();
+			continue;
+		}
 
-			foreach (int pid, pids) {
-				device->addPidFilter(pid, this);
-			}
+		QElapsedTimer timer;
+		timer.start();
+		writeBuffer(buffer);
+		qint64 latency = timer.elapsed();
 
-			if (channel->isScrambled && !pmtSectionData.isEmpty()) {
-				device->startDescrambling(pmtSectionData, this);
-			}
-		} else {
-			// TODO
+		if (latency >= 1000) {
+			qCWarning(logDvb, "Writing to %s took %lld ms", qPrintable(fileName), latency);
+		}
 
-			stop();
+		mutex.lock();
+		++writtenBuffers;
+		totalLatency += latency;
+
+		if (latency > maxLatency) {
+			maxLatency = latency;
 		}
+
+		freeBuffers.append(buffer);
+		mutex.unlock();
 	}
+
+	finishFile();
 }
 
-void DvbRecordingFile::pmtSectionChanged(const QByteArray &pmtSectionData_)
+void DvbRecordingWriter::startFile(int fd_, const QString &fileName_)
 {
-	pmtSectionData = pmtSectionData_;
-	DvbPmtSection pmtSection(pmtSectionData);
-	DvbPmtParser pmtParser(pmtSection);
-	int pcrPid = pmtSection.pcrPid();
-	QSet<int> newPids;
-
-	if (pmtParser.videoPid != -1) {
-		newPids.insert(pmtParser.videoPid);
+	fd = fd_;
+	fileName = fileName_;
+	directIo = false;
+	offset = 0;
+	advisedOffset = 0;
+	syncedOffset = 0;
+	allocatedSize = 0;
+	preallocationFailed = false;
+	elapsedTimer.start();
+
+#ifdef O_DIRECT
+	if (directIoRequested) {
+		// O_DIRECT belongs to the open file description, which the duplicated
+		// descriptor shares with the QFile; so the file is opened separately
+		int directFd = ::open(QFile::encodeName(fileName).constData(), O_WRONLY | O_DIRECT);
+
+		if (directFd >= 0) {
+			::close(fd);
+			fd = directFd;
+			directIo = true;
+		} else {
+			qCWarning(logDvb, "Cannot enable direct io for %s. Error: %d",
+				qPrintable(fileName), errno);
+		}
 	}
+#endif
+}
 
-	for (int i = 0; i < pmtParser.audioPids.size(); ++i) {
-		newPids.insert(pmtParser.audioPids.at(i).first);
+void DvbRecordingWriter::finishFile()
+{
+	if (fd < 0) {
+		return;
 	}
 
-	for (int i = 0; i < pmtParser.subtitlePids.size(); ++i) {
-		newPids.insert(pmtParser.subtitlePids.at(i).first);
+	if (allocatedSize > offset) {
+		// release the preallocated space which wasn't used
+		if (ftruncate(fd, offset) != 0) {
+			qCWarning(logDvb, "Cannot truncate %s. Error: %d", qPrintable(fileName), errno);
+		}
 	}
 
-	if (pmtParser.teletextPid != -1) {
-		newPids.insert(pmtParser.teletextPid);
+	if (::close(fd) != 0) {
+		qCWarning(logDvb, "Cannot close %s. Error: %d", qPrintable(fileName), errno);
 	}
 
-	/* check PCR PID is set */
-	if (pcrPid != 0x1fff) {
-		/* Check not already in list */
-		if (!newPids.contains(pcrPid))
-			newPids.insert(pcrPid);
+	fd = -1;
+	QMutexLocker locker(&mutex);
+
+	if (writtenBuffers > 0) {
+		qCDebug(logDvb, "%s: %d buffers written, average latency %lld ms, maximum latency %lld ms, maximum queue depth %d, %d buffers dropped",
+			qPrintable(fileName), writtenBuffers, totalLatency / writtenBuffers, maxLatency,
+			maxQueueDepth, droppedBuffers);
 	}
 
-	for (int i = 0; i < pids.size(); ++i) {
-		int pid = pids.at(i);
+	droppedBuffers = 0;
+	writtenBuffers = 0;
+	maxQueueDepth = 0;
+	totalLatency = 0;
+	maxLatency = 0;
+}
 
-		if (!newPids.remove(pid)) {
-			device->removePidFilter(pid, this);
-			pids.removeAt(i);
-			--i;
+bool DvbRecordingWriter::writeBuffer(const Buffer &buffer)
+{
+#ifdef O_DIRECT
+	if (directIo && ((buffer.size % BufferAlignment) != 0)) {
+		// only the last buffer can be partially filled
+		int flags = fcntl(fd, F_GETFL);
+
+		if (flags >= 0) {
+			fcntl(fd, F_SETFL, flags & ~O_DIRECT);
 		}
-	}
 
-	foreach (int pid, newPids) {
-		device->addPidFilter(pid, this);
-		pids.append(pid);
+		directIo = false;
 	}
+#endif
 
-	pmtGenerator.initPmt(channel->pmtPid, pmtSection, pids);
+	preallocate(buffer.size);
+	const char *data = buffer.data;
+	int size = buffer.size;
 
-	if (!pmtValid) {
-		pmtValid = true;
-		file.write(patGenerator.generatePackets());
-		file.write(pmtGenerator.generatePackets());
+	while (size > 0) {
+		ssize_t bytes = ::write(fd, data, size);
+
+		if (bytes < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+#ifdef O_DIRECT
+			if (directIo && (errno == EINVAL)) {
+				// the file system doesn't support direct io
+				int flags = fcntl(fd, F_GETFL);
+
+				if (flags >= 0) {
+					fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+				}
 
-		foreach (const QByteArray &buffer, buffers) {
-			file.write(buffer);
+				directIo = false;
+				continue;
+			}
+#endif
+
+			qCWarning(logDvb, "Cannot write to %s. Error: %d", qPrintable(fileName), errno);
+			return false;
 		}
 
-		buffers.clear();
-		patPmtTimer.start(500);
+		data += bytes;
+		size -= int(bytes);
+		offset += bytes;
 	}
 
-	insertPatPmt();
+#ifdef SYNC_FILE_RANGE_WRITE
+	if (!directIo && (offset > syncedOffset)) {
+		// write-behind: start writeback of the new data and wait until the
+		// previous buffer has been written, so that dirty pages don't pile up
+		if (syncedOffset > 0) {
+			qint64 previousOffset = qMax<qint64>(0, syncedOffset - BufferSize);
+			sync_file_range(fd, previousOffset, syncedOffset - previousOffset,
+				SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+				SYNC_FILE_RANGE_WAIT_AFTER);
+		}
+
+		sync_file_range(fd, syncedOffset, offset - syncedOffset, SYNC_FILE_RANGE_WRITE);
+		syncedOffset = offset;
+	}
+#endif
+
+#ifdef POSIX_FADV_DONTNEED
+	if (dropCache && !directIo) {
+		// the most recent buffer may still be under writeback
+		qint64 end = offset - BufferSize;
+
+		if (end > advisedOffset) {
+			posix_fadvise(fd, advisedOffset, end - advisedOffset, POSIX_FADV_DONTNEED);
+			advisedOffset = end;
+		}
+	}
+#endif
+
+	return true;
+}
+
+void DvbRecordingWriter::preallocate(qint64 size)
+{
+#ifdef FALLOC_FL_KEEP_SIZE
+	if (preallocationFailed || ((offset + size) <= allocatedSize)) {
+		return;
+	}
+
+	// allocate large extents to avoid fragmentation; the extent size depends
+	// on the measured bitrate and the remaining time of the recording
+
+	const qint64 minExtent = 64 * 1024 * 1024;
+	const qint64 maxExtent = 1024 * 1024 * 1024;
+	qint64 extent = minExtent;
+	qint64 elapsedMSecs = elapsedTimer.elapsed();
+	qint64 remainingSecs = QDateTime::currentDateTime().toUTC().secsTo(end);
+
+	if ((elapsedMSecs >= 10000) && (remainingSecs > 0)) {
+		extent = qBound(minExtent, (offset * remainingSecs * 1000) / elapsedMSecs, maxExtent);
+	}
+
+	extent = qMax(extent, offset + size - allocatedSize);
+
+	if (fallocate(fd, FALLOC_FL_KEEP_SIZE, allocatedSize, extent) == 0) {
+		allocatedSize += extent;
+	} else {
+		// not supported by the file system (or no space left); don't retry
+		preallocationFailed = true;
+	}
+#else
+	Q_UNUSED(size)
+#endif
+}
+
+DvbRecordingProfile::DvbRecordingProfile(const QString &profile) : maxAudioStreams(-1),
+	subtitles(true), teletext(true)
+{
+	foreach (const QString &item, profile.split(QLatin1Char(';'), QString::SkipEmptyParts)) {
+		QString key = item.section(QLatin1Char('='), 0, 0).trimmed().toLower();
+		QString value = item.section(QLatin1Char('='), 1).trimmed().toLower();
+		QStringList languages;
+
+		foreach (const QString &language, value.split(QLatin1Char(','),
+			 QString::SkipEmptyParts)) {
+			languages.append(language.trimmed());
+		}
+
+		if (key == QLatin1String("audio")) {
+			audioLanguages = languages;
+		} else if (key == QLatin1String("maxaudio")) {
+			maxAudioStreams = value.toInt();
+		} else if (key == QLatin1String("subtitles")) {
+			subtitles = (value != QLatin1String("none"));
+			subtitleLanguages = (subtitles ? languages : QStringList());
+		} else if (key == QLatin1String("teletext")) {
+			teletext = (value != QLatin1String("0"));
+		} else {
+			qCWarning(logDvb, "Unknown key '%s' in recording profile", qPrintable(key));
+		}
+	}
+}
+
+QList<int> DvbRecordingProfile::selectPids(const DvbPmtSection &pmtSection) const
+{
+	DvbPmtParser pmtParser(pmtSection);
+	QList<int> pids;
+
+	if (pmtParser.videoPid != -1) {
+		pids.append(pmtParser.videoPid);
+	}
+
+	QList<int> audioPids;
+
+	if (audioLanguages.isEmpty()) {
+		for (int i = 0; i < pmtParser.audioPids.size(); ++i) {
+			audioPids.append(pmtParser.audioPids.at(i).first);
+		}
+	} else {
+		foreach (const QString &language, audioLanguages) {
+			for (int i = 0; i < pmtParser.audioPids.size(); ++i) {
+				int pid = pmtParser.audioPids.at(i).first;
+
+				if ((pmtParser.audioPids.at(i).second.toLower() == language) &&
+				    !audioPids.contains(pid)) {
+					audioPids.append(pid);
+				}
+			}
+		}
+
+		// never create a recording without sound because of a missing language
+		if (audioPids.isEmpty() && !pmtParser.audioPids.isEmpty()) {
+			audioPids.append(pmtParser.audioPids.at(0).first);
+		}
+	}
+
+	if ((maxAudioStreams >= 0) && (audioPids.size() > maxAudioStreams)) {
+		audioPids = audioPids.mid(0, maxAudioStreams);
+	}
+
+	pids += audioPids;
+
+	if (subtitles) {
+		for (int i = 0; i < pmtParser.subtitlePids.size(); ++i) {
+			if (subtitleLanguages.isEmpty() || subtitleLanguages.contains(
+			    pmtParser.subtitlePids.at(i).second.toLower())) {
+				pids.append(pmtParser.subtitlePids.at(i).first);
+			}
+		}
+	}
+
+	if (teletext && (pmtParser.teletextPid != -1)) {
+		pids.append(pmtParser.teletextPid);
+	}
+
+	int pcrPid = pmtSection.pcrPid();
+
+	if ((pcrPid != 0x1fff) && !pids.contains(pcrPid)) {
+		pids.append(pcrPid);
+	}
+
+	return pids;
+}
+
+void DvbRecordingPacketRing::reset(int maxSize)
+{
+	capacity = qMax(maxSize / 188, 1);
+	data.resize(capacity * 188);
+	begin = 0;
+	count = 0;
+}
+
+void DvbRecordingPacketRing::clear()
+{
+	data.clear();
+	capacity = 0;
+	begin = 0;
+	count = 0;
+}
+
+bool DvbRecordingPacketRing::append(const char packet[188])
+{
+	if (capacity == 0) {
+		return false;
+	}
+
+	if (count < capacity) {
+		memcpy(data.data() + (((begin + count) % capacity) * 188), packet, 188);
+		++count;
+		return true;
+	}
+
+	memcpy(data.data() + (begin * 188), packet, 188);
+	begin = ((begin + 1) % capacity);
+	return false;
+}
+
+void DvbRecordingPacketRing::writeTo(DvbRecordingWriter &writer) const
+{
+	int firstCount = qMin(count, capacity - begin);
+	writer.write(data.constData() + (begin * 188), firstCount * 188);
+	writer.write(data.constData(), (count - firstCount) * 188);
+}
+
+DvbMuxCapture::DvbMuxCapture(DvbManager *manager_, const DvbSharedChannel &channel) :
+	manager(manager_), source(channel->source), transponder(channel->transponder), device(NULL)
+{
+	QString folder = manager->getRecordingFolder();
+	QString fileName = QLatin1String(".mux-") +
+		QDateTime::currentDateTime().toString(QLatin1String("yyyyMMdd-hhmmss-zzz")) +
+		QLatin1String(".m2t");
+	file.setFileName(folder + QLatin1Char('/') + fileName);
+
+	if (!file.open(QIODevice::WriteOnly)) {
+		file.setFileName(QDir::homePath() + QLatin1Char('/') + fileName);
+
+		if (!file.open(QIODevice::WriteOnly)) {
+			qCWarning(logDvb, "Cannot open file %s", qPrintable(file.fileName()));
+			return;
+		}
+	}
+
+	device = manager->requestDevice(source, transponder, DvbManager::Prioritized);
+
+	if (device == NULL) {
+		qCWarning(logDvb, "Cannot find a suitable device");
+		return;
+	}
+
+	if (!device->addPidFilter(0x2000, this)) {
+		qCWarning(logDvb, "Device doesn't support capturing the whole transport stream");
+		manager->releaseDevice(device, DvbManager::Prioritized);
+		device = NULL;
+		return;
+	}
+
+	connect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+	writer.open(file.handle(), file.fileName(), QDateTime(), manager->recordingDirectIo(),
+		manager->recordingDropCache());
+}
+
+DvbMuxCapture::~DvbMuxCapture()
+{
+	// normally the capture has already been finished by removeService()
+	finish();
+}
+
+bool DvbMuxCapture::matches(const DvbSharedChannel &channel) const
+{
+	return ((device != NULL) && (channel->source == source) &&
+		channel->transponder.corresponds(transponder));
+}
+
+void DvbMuxCapture::addService(const DvbRecordingFile *recordingFile,
+	const DvbSharedChannel &channel, const DvbRecordingProfile &profile,
+	const QString &fileName)
+{
+	DvbMuxSplitJob job;
+	job.fileName = fileName;
+	job.transportStreamId = channel->transportStreamId;
+	job.serviceId = channel->serviceId;
+	job.pmtPid = channel->pmtPid;
+	job.profile = profile;
+	job.begin = writer.position();
+	job.end = job.begin;
+	job.pmtSections.append(qMakePair(job.begin, channel->pmtSectionData));
+	activeJobs.insert(recordingFile, job);
+}
+
+void DvbMuxCapture::updatePmt(const DvbRecordingFile *recordingFile,
+	const QByteArray &pmtSectionData)
+{
+	QHash<const DvbRecordingFile *, DvbMuxSplitJob>::Iterator it =
+		activeJobs.find(recordingFile);
+
+	if (it == activeJobs.end()) {
+		return;
+	}
+
+	qint64 offset = writer.position();
+
+	if (it->pmtSections.last().first == offset) {
+		// nothing has been captured with the previous pmt
+		it->pmtSections.last().second = pmtSectionData;
+	} else if (it->pmtSections.last().second != pmtSectionData) {
+		it->pmtSections.append(qMakePair(offset, pmtSectionData));
+	}
+}
+
+void DvbMuxCapture::removeService(const DvbRecordingFile *recordingFile)
+{
+	if (!activeJobs.contains(recordingFile)) {
+		return;
+	}
+
+	DvbMuxSplitJob job = activeJobs.take(recordingFile);
+	job.end = writer.position();
+
+	if (job.end > job.begin) {
+		finishedJobs.append(job);
+	}
+
+	if (activeJobs.isEmpty()) {
+		finish();
+	}
+}
+
+void DvbMuxCapture::deviceStateChanged()
+{
+	if (device->getDeviceState() == DvbDevice::DeviceReleased) {
+		device->removePidFilter(0x2000, this);
+		disconnect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+		device = manager->requestDevice(source, transponder, DvbManager::Prioritized);
+
+		if (device != NULL) {
+			connect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+			device->addPidFilter(0x2000, this);
+		}
+	}
+}
+
+void DvbMuxCapture::processData(const char data[188])
+{
+	writer.write(data, 188);
+}
+
+void DvbMuxCapture::finish()
+{
+	if (device != NULL) {
+		device->removePidFilter(0x2000, this);
+		disconnect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+		manager->releaseDevice(device, DvbManager::Prioritized);
+		device = NULL;
+	}
+
+	if (!file.isOpen()) {
+		return;
+	}
+
+	writer.close();
+
+	foreach (DvbMuxSplitJob job, activeJobs) {
+		job.end = writer.position();
+
+		if (job.end > job.begin) {
+			finishedJobs.append(job);
+		}
+	}
+
+	activeJobs.clear();
+	file.close();
+
+	if (finishedJobs.isEmpty()) {
+		QFile::remove(file.fileName());
+		return;
+	}
+
+	// splitting may take a while, so it's done in the background
+	DvbMuxSplitter *splitter = new DvbMuxSplitter(file.fileName(), finishedJobs,
+		manager->getRecordingModel());
+	connect(splitter, SIGNAL(finished()), splitter, SLOT(deleteLater()));
+	splitter->start(QThread::LowPriority);
+	finishedJobs.clear();
+}
+
+void DvbMuxSplitter::run()
+{
+	QFile muxFile(muxFileName);
+
+	if (!muxFile.open(QIODevice::ReadOnly)) {
+		qCWarning(logDvb, "Cannot open file %s", qPrintable(muxFileName));
+		return;
+	}
+
+	foreach (const DvbMuxSplitJob &job, jobs) {
+		if (isInterruptionRequested()) {
+			qCWarning(logDvb, "Splitting of %s was interrupted", qPrintable(muxFileName));
+			break;
+		}
+
+		split(muxFile, job);
+	}
+
+	muxFile.close();
+
+	if (!QFile::remove(muxFileName)) {
+		qCWarning(logDvb, "Cannot remove file %s", qPrintable(muxFileName));
+	}
+}
+
+void DvbMuxSplitter::split(QFile &muxFile, const DvbMuxSplitJob &job)
+{
+	QFile file(job.fileName);
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qCWarning(logDvb, "Cannot open file %s", qPrintable(job.fileName));
+		return;
+	}
+
+	DvbSectionGenerator patGenerator;
+	DvbSectionGenerator pmtGenerator;
+	patGenerator.initPat(job.transportStreamId, job.serviceId, job.pmtPid);
+	QVector<bool> selectedPids(0x2000, false);
+	bool pmtValid = false;
+	int pmtIndex = 0;
+
+	SeekIndexWriter seekIndex;
+	seekIndex.open(SeekIndexWriter::indexFileName(job.fileName));
+	qint64 outputOffset = 0;
+
+	if (!muxFile.seek(job.begin)) {
+		qCWarning(logDvb, "Cannot seek in file %s", qPrintable(muxFileName));
+		return;
+	}
+
+	const int bufferSize = 4096 * 188;
+	qint64 offset = job.begin;
+	QByteArray output;
+	output.reserve(bufferSize + 4 * 188);
+
+	while ((offset < job.end) && !isInterruptionRequested()) {
+		qint64 end = job.end;
+
+		// the streams are selected again at every pmt change
+		while ((pmtIndex < job.pmtSections.size()) &&
+		       (job.pmtSections.at(pmtIndex).first <= offset)) {
+			DvbPmtSection pmtSection(job.pmtSections.at(pmtIndex).second);
+			++pmtIndex;
+			pmtValid = pmtSection.isValid();
+			selectedPids.fill(false);
+
+			if (!pmtValid) {
+				qCWarning(logDvb, "No valid pmt for a part of %s",
+					qPrintable(job.fileName));
+				continue;
+			}
+
+			QList<int> pids = job.profile.selectPids(pmtSection);
+
+			foreach (int pid, pids) {
+				selectedPids[pid & 0x1fff] = true;
+			}
+
+			pmtGenerator.initPmt(job.pmtPid, pmtSection, pids);
+			DvbPmtParser pmtParser(pmtSection);
+			seekIndex.setStreams(pids.contains(pmtParser.videoPid) ?
+				pmtParser.videoPid : -1, pmtParser.videoStreamType,
+				pmtSection.pcrPid());
+		}
+
+		if (pmtIndex < job.pmtSections.size()) {
+			end = qMin(end, job.pmtSections.at(pmtIndex).first);
+		}
+
+		QByteArray input = muxFile.read(qMin<qint64>(end - offset, bufferSize));
+
+		if (input.size() < 188) {
+			break;
+		}
+
+		offset += input.size();
+
+		if (!pmtValid) {
+			continue;
+		}
+
+		// pat and pmt are repeated for every chunk (several times per second)
+		output.append(patGenerator.generatePackets());
+		output.append(pmtGenerator.generatePackets());
+
+		for (int i = 0; (i + 188) <= input.size(); i += 188) {
+			const char *packet = (input.constData() + i);
+			int pid = ((static_cast<unsigned char>(packet[1]) << 8) |
+				static_cast<unsigned char>(packet[2])) & 0x1fff;
+
+			if (selectedPids.at(pid)) {
+				seekIndex.processPacket(packet, outputOffset + output.size());
+				output.append(packet, 188);
+			}
+		}
+
+		if (file.write(output) != output.size()) {
+			qCWarning(logDvb, "Cannot write to %s", qPrintable(job.fileName));
+			return;
+		}
+
+		outputOffset += output.size();
+		output.clear();
+	}
+}
+
+DvbRecordingFile::DvbRecordingFile(DvbManager *manager_) : manager(manager_), muxMode(false),
+	segmentDuration(0), segmentNumber(0), segmentsFailed(false), playlistPending(false),
+	eventState(EventIgnored), eventId(-1), finished(false),
+	prePmtTimeBudget(0), droppedPrePmtPackets(0), device(NULL), pmtValid(false)
+{
+	connect(&pmtFilter, SIGNAL(pmtSectionChanged(QByteArray)),
+		this, SLOT(pmtSectionChanged(QByteArray)));
+}
+
+DvbRecordingFile::~DvbRecordingFile()
+{
+	stop();
+}
+
+bool DvbRecordingFile::start(DvbRecording &recording)
+{
+	if (recording.disabled) {
+		return false;
+	}
+
+	if (finished) {
+		// the tuner has already been released
+		return true;
+	}
+
+	if (!file.isOpen()) {
+		QString folder = manager->getRecordingFolder();
+		QDate currentDate = QDate::currentDate();
+		QTime currentTime = QTime::currentTime();
+
+		QString filename = manager->getNamingFormat();
+		filename = filename.replace("%year", currentDate.toString("yyyy"));
+		filename = filename.replace("%month", currentDate.toString("MM"));
+		filename = filename.replace("%day", currentDate.toString("dd"));
+		filename = filename.replace("%hour", currentTime.toString("hh"));
+		filename = filename.replace("%min", currentTime.toString("mm"));
+		filename = filename.replace("%sec", currentTime.toString("ss"));
+		filename = filename.replace("%channel", recording.channel->name);
+		filename = filename.replace("%title", QString(recording.name));
+		filename = filename.replace(QLatin1Char('/'), QLatin1Char('_'));
+		if (filename.isEmpty()) {
+			filename = QString(recording.name);
+		}
+
+		QString path = folder + QLatin1Char('/') + filename;
+
+		muxMode = manager->isMuxCapture();
+		segmentDuration = (muxMode ? 0 : (manager->getRecordingSegmentDuration() * 1000));
+		segmentNumber = 1;
+		segmentsFailed = false;
+		playlistPending = false;
+
+		// a segmented recording is represented by its playlist
+		QString extension = ((segmentDuration > 0) ? QLatin1String(".m3u8") :
+			QLatin1String(".m2t"));
+
+		for (int attempt = 0; attempt < 100; ++attempt) {
+			QString suffix;
+
+			if (attempt != 0) {
+				suffix = QLatin1String("-") + QString::number(attempt);
+			}
+
+			segmentBaseName = path + suffix;
+			recording.filename = filename + suffix + extension;
+
+			if (segmentDuration > 0) {
+				file.setFileName(segmentFileName(segmentNumber));
+			} else {
+				file.setFileName(segmentBaseName + extension);
+			}
+
+			if (file.exists() || QFile::exists(segmentBaseName + extension)) {
+				continue;
+			}
+
+			if (file.open(QIODevice::WriteOnly)) {
+				break;
+			} else {
+				qCWarning(logDvb, "Cannot open file %s. Error: %d", qPrintable(file.fileName()), errno);
+			}
+
+			if ((attempt == 0) && !QDir(folder).exists()) {
+				if (QDir().mkpath(folder)) {
+					attempt = -1;
+					continue;
+				} else {
+					qCWarning(logDvb, "Cannot create folder %s", qPrintable(folder));
+				}
+			}
+
+			if (folder != QDir::homePath()) {
+				folder = QDir::homePath();
+				path = folder + QLatin1Char('/') +
+					QString(recording.name).replace(QLatin1Char('/'), QLatin1Char('_'));
+				attempt = -1;
+				continue;
+			}
+
+			break;
+		}
+
+		if (manager->createInfoFile()) {
+			QString infoFile = path + ".txt";
+			QFile file(infoFile);
+			if (file.open(QIODevice::ReadWrite))
+			{
+			    QTextStream stream(&file);
+			    stream << "EPG info" << endl;
+			    stream << "Title: " + QString(recording.name) << endl;
+			    stream << "Description: " + QString(recording.subheading) << endl;
+			    //stream << "Details: " + QString(recording.details) << endl; // Details is almost always empty
+			    stream << "Channel: " + QString(recording.channel->name) << endl;
+			    stream << "Date: " + recording.beginEPG.toLocalTime().toString("yyyy-MM-dd") << endl;
+			    stream << "Start time: " + recording.beginEPG.toLocalTime().toString("hh:mm:ss") << endl;
+			    stream << "Duration: " + recording.durationEPG.toString("HH:mm:ss") << endl;
+			}
+		}
+
+		if (!file.isOpen()) {
+			qCWarning(logDvb, "Cannot open file %s", qPrintable(file.fileName()));
+			return false;
+		}
+
+		profile = DvbRecordingProfile(recording.profile.isEmpty() ?
+			manager->getRecordingProfile() : recording.profile);
+
+		// only recordings of epg events can follow the running status
+		if (manager->isRecordingRunningStatus() && !muxMode && recording.beginEPG.isValid()) {
+			eventState = EventUnknown;
+			eventBegin = recording.beginEPG.toUTC();
+			eventId = -1;
+			recordingBegin = recording.begin;
+			recordingEnd = recording.end;
+
+			if ((eventBegin < recordingBegin) || (eventBegin >= recordingEnd)) {
+				// a later repetition
+				eventBegin = QDateTime();
+			}
+		}
+
+		if (segmentDuration > 0) {
+			// the size of a segment doesn't depend on the end of the recording
+			writer.open(file.handle(), file.fileName(), QDateTime(),
+				manager->recordingDirectIo(), manager->recordingDropCache());
+			seekIndex.open(SeekIndexWriter::indexFileName(file.fileName()));
+			writePlaylist(false);
+		} else if (!muxMode) {
+			writer.open(file.handle(), file.fileName(), recording.end,
+				manager->recordingDirectIo(), manager->recordingDropCache());
+			seekIndex.open(SeekIndexWriter::indexFileName(file.fileName()));
+		}
+	}
+
+	if (device == NULL) {
+		channel = recording.channel;
+		device = manager->requestDevice(channel->source, channel->transponder,
+			DvbManager::Prioritized);
+
+		if (device == NULL) {
+			qCWarning(logDvb, "Cannot find a suitable device");
+			return false;
+		}
+
+		/*
+		 * When there's not enough devices to record while
+		 * watching, switch to the channel that will be recorded
+		 */
+		if (manager->hasReacquired())
+			manager->getLiveView()->playChannel(channel);
+
+		connect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+
+		if (eventState != EventIgnored) {
+			manager->getEpgModel()->startEventFilter(device, channel);
+		}
+
+		if (muxMode) {
+			muxCapture = manager->getRecordingModel()->getMuxCapture(channel);
+
+			if (muxCapture.constData() != NULL) {
+				muxCapture->addService(this, channel, profile, file.fileName());
+			} else {
+				muxMode = false;
+				writer.open(file.handle(), file.fileName(), recording.end,
+					manager->recordingDirectIo(), manager->recordingDropCache());
+				seekIndex.open(SeekIndexWriter::indexFileName(file.fileName()));
+			}
+		}
+
+		pmtFilter.setProgramNumber(channel->serviceId);
+		device->addSectionFilter(channel->pmtPid, &pmtFilter);
+		pmtSectionData = channel->pmtSectionData;
+		patGenerator.initPat(channel->transportStreamId, channel->serviceId,
+			channel->pmtPid);
+
+		if (channel->isScrambled && !pmtSectionData.isEmpty()) {
+			device->startDescrambling(pmtSectionData, this);
+		}
+
+		if ((muxCapture.constData() == NULL) && !pmtSectionData.isEmpty()) {
+			// the streams of the stored pmt are buffered until the pmt is received
+			// (or replaced by it after a second, see processData())
+			DvbPmtSection pmtSection(pmtSectionData);
+
+			if (pmtSection.isValid()) {
+				foreach (int pid, profile.selectPids(pmtSection)) {
+					if (device->addPidFilter(pid, this)) {
+						pids.append(pid);
+					}
+				}
+			}
+		}
+	}
+
+	manager->getRecordingModel()->setCurrentRecording(recording);
+
+	return true;
+}
+
+void DvbRecordingFile::stop()
+{
+	if (finished) {
+		return;
+	}
+
+	if (device != NULL) {
+		if (eventState != EventIgnored) {
+			manager->getEpgModel()->stopEventFilter(device, channel);
+		}
+
+		if (channel->isScrambled && !pmtSectionData.isEmpty()) {
+			device->stopDescrambling(pmtSectionData, this);
+		}
+
+		foreach (int pid, pids) {
+			device->removePidFilter(pid, this);
+		}
+
+		device->removeSectionFilter(channel->pmtPid, &pmtFilter);
+		disconnect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+		manager->releaseDevice(device, DvbManager::Prioritized);
+		device = NULL;
+	}
+
+	pmtValid = false;
+	patGenerator.reset();
+	pmtGenerator.reset();
+	pmtSectionData.clear();
+	pids.clear();
+	prePmtTimer.invalidate();
+	prePmtPackets.clear();
+	droppedPrePmtPackets = 0;
+
+	if (muxCapture.constData() != NULL) {
+		muxCapture->removeService(this);
+		muxCapture = QExplicitlySharedDataPointer<DvbMuxCapture>();
+	}
+
+	muxMode = false;
+
+	if ((segmentDuration > 0) && file.isOpen()) {
+		finishSegment(true);
+	}
+
+	segmentDuration = 0;
+	segmentsFailed = false;
+	playlistPending = false;
+	segmentFileNames.clear();
+	segmentDurations.clear();
+	eventState = EventIgnored;
+	eventBegin = QDateTime();
+	eventId = -1;
+	seekIndex.close();
+	writer.close();
+	file.close();
+	channel = DvbSharedChannel();
+
+	manager->getRecordingModel()->executeActionAfterRecording(manager->getRecordingModel()->getCurrentRecording());
+}
+
+void DvbRecordingFile::deviceStateChanged()
+{
+	if (device->getDeviceState() == DvbDevice::DeviceReleased) {
+		if (eventState != EventIgnored) {
+			manager->getEpgModel()->stopEventFilter(device, channel);
+		}
+
+		foreach (int pid, pids) {
+			device->removePidFilter(pid, this);
+		}
+
+		device->removeSectionFilter(channel->pmtPid, &pmtFilter);
+		disconnect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+
+		if (channel->isScrambled && !pmtSectionData.isEmpty()) {
+			device->stopDescrambling(pmtSectionData, this);
+		}
+
+		device = manager->requestDevice(channel->source, channel->transponder,
+			DvbManager::Prioritized);
+
+		if (device != NULL) {
+			connect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+			device->addSectionFilter(channel->pmtPid, &pmtFilter);
+
+			foreach (int pid, pids) {
+				device->addPidFilter(pid, this);
+			}
+
+			if (eventState != EventIgnored) {
+				manager->getEpgModel()->startEventFilter(device, channel);
+			}
+
+			if (channel->isScrambled && !pmtSectionData.isEmpty()) {
+				device->startDescrambling(pmtSectionData, this);
+			}
+		} else {
+			// TODO
+
+			stop();
+		}
+	}
+}
+
+void DvbRecordingFile::pmtSectionChanged(const QByteArray &pmtSectionData_)
+{
+	pmtSectionData = pmtSectionData_;
+	DvbPmtSection pmtSection(pmtSectionData);
+
+	if (muxCapture.constData() != NULL) {
+		// the streams are selected when the mux capture is split
+		muxCapture->updatePmt(this, pmtSectionData);
+
+		if (channel->isScrambled) {
+			device->startDescrambling(pmtSectionData, this);
+		}
+
+		return;
+	}
+
+	QSet<int> newPids = profile.selectPids(pmtSection).toSet();
+
+	for (int i = 0; i < pids.size(); ++i) {
+		int pid = pids.at(i);
+
+		if (!newPids.remove(pid)) {
+			device->removePidFilter(pid, this);
+			pids.removeAt(i);
+			--i;
+		}
+	}
+
+	foreach (int pid, newPids) {
+		device->addPidFilter(pid, this);
+		pids.append(pid);
+	}
+
+	pmtGenerator.initPmt(channel->pmtPid, pmtSection, pids);
+	updateSeekIndexStreams();
+
+	if (!pmtValid) {
+		pmtValid = true;
+		insertPatPmt();
+
+		prePmtPackets.writeTo(writer);
+		prePmtPackets.clear();
+
+		if (droppedPrePmtPackets > 0) {
+			qCWarning(logDvb, "Dropped %d packets of %s before the pmt was received",
+				droppedPrePmtPackets, qPrintable(channel->name));
+			droppedPrePmtPackets = 0;
+		}
+	} else {
+		insertPatPmt();
+	}
 
 	if (channel->isScrambled) {
 		device->startDescrambling(pmtSectionData, this);
 	}
 }
 
-void DvbRecordingFile::insertPatPmt()
+void DvbRecordingFile::updateRunningStatus(const DvbSharedChannel &channel_, int eventId_,
+	const QDateTime &begin, int runningStatus, bool present)
 {
-	if (!pmtValid) {
-		pmtSectionChanged(channel->pmtSectionData);
+	if ((eventState == EventIgnored) || (channel_ != channel)) {
+		return;
+	}
+
+	if (eventId < 0) {
+		if (eventBegin.isValid()) {
+			if (begin != eventBegin) {
+				return;
+			}
+		} else if (!present || (runningStatus != 4) || (begin < recordingBegin) ||
+			   (begin >= recordingEnd)) {
+			return;
+		}
+
+		eventId = eventId_;
+	}
+
+	if (eventId_ == eventId) {
+		// a delayed or overrunning event keeps its event id
+		switch (runningStatus) {
+		case 1: // not running
+		case 2: // starts in a few seconds
+			if (eventState == EventRunning) {
+				// the device can't be released while processing data
+				QTimer::singleShot(0, this, SLOT(finishEvent()));
+			} else if (eventState != EventWaiting) {
+				qCDebug(logDvb, "Waiting for the start of %s", qPrintable(channel->name));
+				eventState = EventWaiting;
+			}
+
+			break;
+		case 3: // pausing
+		case 4: // running
+			if (eventState != EventRunning) {
+				qCDebug(logDvb, "Event on %s is running", qPrintable(channel->name));
+				eventState = EventRunning;
+			}
+
+			break;
+		default: // undefined or service off-air
+			break;
+		}
+	} else if (present && (runningStatus == 4) && (eventState == EventRunning)) {
+		// the next event has started
+		QTimer::singleShot(0, this, SLOT(finishEvent()));
+	}
+}
+
+void DvbRecordingFile::finishEvent()
+{
+	if (finished) {
 		return;
 	}
 
-	file.write(patGenerator.generatePackets());
-	file.write(pmtGenerator.generatePackets());
+	qCDebug(logDvb, "Event on %s has ended, stopping the recording", qPrintable(channel->name));
+	stop();
+	finished = true;
+	manager->getRecordingModel()->removeDuplicates();
+	manager->getRecordingModel()->disableConflicts();
+}
+
+void DvbRecordingFile::insertPatPmt()
+{
+	writer.write(patGenerator.generatePackets());
+	writer.write(pmtGenerator.generatePackets());
+	patPmtRepetition.reset();
 }
 
 void DvbRecordingFile::processData(const char data[188])
 {
 	if (!pmtValid) {
-		if (!patPmtTimer.isActive()) {
-			patPmtTimer.start(1000);
-			QByteArray nextBuffer;
-			nextBuffer.reserve(348 * 188);
-			buffers.append(nextBuffer);
+		if (!prePmtTimer.isValid()) {
+			prePmtTimer.start();
+			prePmtPackets.reset(manager->getPrePmtBufferSize() * 1024);
+			prePmtTimeBudget = (manager->getPrePmtBufferTime() * 1000);
+		}
+
+		if ((prePmtTimer.elapsed() >= 1000) && !channel->pmtSectionData.isEmpty()) {
+			// no pmt received so far; use the one of the channel
+			pmtSectionChanged(channel->pmtSectionData);
+		}
+	}
+
+	if (!pmtValid) {
+		if (prePmtTimer.elapsed() > prePmtTimeBudget) {
+			// a broken or scrambled channel mustn't fill the memory
+			if (!prePmtPackets.isEmpty()) {
+				qCWarning(logDvb, "No pmt received for %s, discarding buffered data",
+					qPrintable(channel->name));
+				droppedPrePmtPackets += prePmtPackets.size();
+				prePmtPackets.clear();
+			}
+
+			++droppedPrePmtPackets;
+			return;
+		}
+
+		if (!prePmtPackets.append(data)) {
+			if (droppedPrePmtPackets == 0) {
+				qCWarning(logDvb, "Pre-pmt buffer of %s is full, dropping old packets",
+					qPrintable(channel->name));
+			}
+
+			++droppedPrePmtPackets;
 		}
 
-		QByteArray &buffer = buffers.last();
-		buffer.append(data, 188);
+		return;
+	}
+
+	if (eventState == EventWaiting) {
+		return;
+	}
+
+	bool randomAccessPoint = seekIndex.isRandomAccessPoint(data);
+
+	if ((segmentDuration > 0) && !segmentsFailed && (seekIndex.time() >= segmentDuration)) {
+		// cut at a random access point; without video (or if no random access
+		// point can be found) at the start of a pes packet
+		bool pesStart = ((data[1] & 0x40) != 0);
 
-		if (buffer.size() >= (348 * 188)) {
-			QByteArray nextBuffer;
-			nextBuffer.reserve(348 * 188);
-			buffers.append(nextBuffer);
+		if (randomAccessPoint || (pesStart &&
+		    (!seekIndex.hasVideo() || (seekIndex.time() >= (2 * segmentDuration))))) {
+			startSegment();
 		}
+	}
+
+	if (playlistPending && (writer.finishedFiles() >= segmentFileNames.size())) {
+		// the previous segment has been completed by the writer thread
+		playlistPending = false;
+		writePlaylist(false);
+	}
+
+	if (patPmtRepetition.check(randomAccessPoint, seekIndex.time())) {
+		insertPatPmt();
+	}
+
+	seekIndex.processPacket(data, writer.position());
+	writer.write(data, 188);
+}
+
+void DvbRecordingFile::updateSeekIndexStreams()
+{
+	DvbPmtSection pmtSection(pmtSectionData);
+	DvbPmtParser pmtParser(pmtSection);
+	seekIndex.setStreams(pids.contains(pmtParser.videoPid) ? pmtParser.videoPid : -1,
+		pmtParser.videoStreamType, pmtSection.pcrPid());
+}
+
+QString DvbRecordingFile::segmentFileName(int number) const
+{
+	return segmentBaseName + QLatin1Char('.') +
+		QString(QLatin1String("%1")).arg(number, 5, 10, QLatin1Char('0')) +
+		QLatin1String(".m2t");
+}
+
+void DvbRecordingFile::startSegment()
+{
+	QString previousFileName = file.fileName();
+	// the writer has its own descriptor of the previous segment
+	file.close();
+	file.setFileName(segmentFileName(segmentNumber + 1));
+
+	if (!file.open(QIODevice::WriteOnly)) {
+		qCWarning(logDvb, "Cannot open file %s. Error: %d; continuing %s",
+			qPrintable(file.fileName()), errno, qPrintable(previousFileName));
+		// the writer still writes into the previous segment
+		file.setFileName(previousFileName);
+		file.open(QIODevice::WriteOnly | QIODevice::Append);
+		segmentsFailed = true;
+		return;
+	}
+
+	++segmentNumber;
+	segmentFileNames.append(previousFileName);
+	segmentDurations.append(int(qMax<qint64>(seekIndex.time(), 0)));
+	// the playlist is updated once the writer has completed the previous segment
+	playlistPending = true;
+	writer.switchFile(file.handle(), file.fileName());
+	seekIndex.open(SeekIndexWriter::indexFileName(file.fileName()));
+	updateSeekIndexStreams();
+	insertPatPmt();
+}
+
+void DvbRecordingFile::finishSegment(bool lastSegment)
+{
+	segmentFileNames.append(file.fileName());
+	segmentDurations.append(int(qMax<qint64>(seekIndex.time(), 0)));
+	seekIndex.close();
+	writer.close();
+	file.close();
+	writePlaylist(lastSegment);
+}
+
+void DvbRecordingFile::writePlaylist(bool complete)
+{
+	// the playlist is replaced atomically, so that it can be read at any time
+	QSaveFile playlist(segmentBaseName + QLatin1String(".m3u8"));
 
+	if (!playlist.open(QIODevice::WriteOnly)) {
+		qCWarning(logDvb, "Cannot open file %s", qPrintable(playlist.fileName()));
 		return;
 	}
 
-	file.write(data, 188);
+	int targetDuration = ((segmentDuration + 999) / 1000);
+	int mediaSequence = -1;
+	QString entries;
+
+	for (int i = 0; i < segmentFileNames.size(); ++i) {
+		// segments may be removed by the user while recording
+		if (!QFile::exists(segmentFileNames.at(i))) {
+			continue;
+		}
+
+		if (mediaSequence < 0) {
+			mediaSequence = (i + 1);
+		}
+
+		int duration = segmentDurations.at(i);
+		targetDuration = qMax(targetDuration, (duration + 999) / 1000);
+		entries += QLatin1String("#EXTINF:") + QString::number(duration / 1000.0, 'f', 3) +
+			QLatin1String(",\n") + QFileInfo(segmentFileNames.at(i)).fileName() +
+			QLatin1Char('\n');
+	}
+
+	QTextStream stream(&playlist);
+	stream << "#EXTM3U\n";
+	stream << "#EXT-X-VERSION:3\n";
+	stream << "#EXT-X-TARGETDURATION:" << targetDuration << '\n';
+	stream << "#EXT-X-MEDIA-SEQUENCE:" << qMax(mediaSequence, 1) << '\n';
+	stream << entries;
+
+	if (complete) {
+		stream << "#EXT-X-ENDLIST\n";
+	}
+
+	stream.flush();
+
+	if (!playlist.commit()) {
+		qCWarning(logDvb, "Cannot write file %s", qPrintable(playlist.fileName()));
+	}
+}
+
+
+DvbRecordingScheduler::DvbRecordingScheduler(const QList<DvbDeviceConfig> &deviceConfigs)
+{
+	// every device config corresponds to one frontend; unplugged devices are
+	// included, because they may be available when the recording starts
+
+	foreach (const DvbDeviceConfig &deviceConfig, deviceConfigs) {
+		QStringList sources;
+
+		foreach (const DvbConfig &config, deviceConfig.configs) {
+			sources.append(config->name);
+		}
+
+		if (!sources.isEmpty()) {
+			tunerSources.append(sources);
+		}
+	}
+}
+
+static bool recordingBeginLessThan(const DvbSharedRecording &x, const DvbSharedRecording &y)
+{
+	if (x->begin != y->begin) {
+		return (x->begin < y->begin);
+	}
+
+	return (x->sqlKey < y->sqlKey);
+}
+
+static bool recordingMoreImportant(const DvbSharedRecording &x, const DvbSharedRecording &y)
+{
+	bool xRecording = (x->status == DvbRecording::Recording);
+	bool yRecording = (y->status == DvbRecording::Recording);
+
+	if (xRecording != yRecording) {
+		return xRecording;
+	}
+
+	if (x->priority != y->priority) {
+		return (x->priority > y->priority);
+	}
+
+	return recordingBeginLessThan(x, y);
+}
+
+QList<DvbSharedRecording> DvbRecordingScheduler::findConflicts(
+	QList<DvbSharedRecording> recordings) const
+{
+	QList<DvbSharedRecording> conflicts;
+
+	// recordings which can't be tuned at all are left alone
+
+	for (int i = 0; i < recordings.size();) {
+		if (isSupported(recordings.at(i))) {
+			++i;
+		} else {
+			recordings.removeAt(i);
+		}
+	}
+
+	std::sort(recordings.begin(), recordings.end(), recordingBeginLessThan);
+
+	// sweep over the recordings; only overlapping recordings can be in conflict
+
+	int clusterBegin = 0;
+
+	while (clusterBegin < recordings.size()) {
+		QDateTime clusterEnd = recordings.at(clusterBegin)->end;
+		int clusterSize = 1;
+
+		while ((clusterBegin + clusterSize) < recordings.size()) {
+			const DvbSharedRecording &recording = recordings.at(clusterBegin + clusterSize);
+
+			if (recording->begin >= clusterEnd) {
+				break;
+			}
+
+			if (recording->end > clusterEnd) {
+				clusterEnd = recording->end;
+			}
+
+			++clusterSize;
+		}
+
+		if (clusterSize > 1) {
+			QList<DvbSharedRecording> cluster = recordings.mid(clusterBegin, clusterSize);
+			std::sort(cluster.begin(), cluster.end(), recordingMoreImportant);
+			QList<DvbSharedRecording> accepted;
+
+			foreach (const DvbSharedRecording &recording, cluster) {
+				if (fits(recording, accepted)) {
+					// 'accepted' is kept sorted by begin (see fits())
+					accepted.insert(std::upper_bound(accepted.begin(),
+						accepted.end(), recording, recordingBeginLessThan),
+						recording);
+				} else {
+					conflicts.append(recording);
+				}
+			}
+		}
+
+		clusterBegin += clusterSize;
+	}
+
+	return conflicts;
+}
+
+bool DvbRecordingScheduler::isSupported(const DvbSharedRecording &recording) const
+{
+	if (!recording->channel.isValid()) {
+		return false;
+	}
+
+	foreach (const QStringList &sources, tunerSources) {
+		if (sources.contains(recording->channel->source)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool DvbRecordingScheduler::fits(const DvbSharedRecording &recording,
+	const QList<DvbSharedRecording> &accepted) const
+{
+	// only accepted recordings overlapping the new one matter; as 'accepted' is
+	// sorted by begin, the search stops at the first one beginning after it
+
+	QList<DvbSharedRecording> overlapping;
+
+	foreach (const DvbSharedRecording &acceptedRecording, accepted) {
+		if (acceptedRecording->begin >= recording->end) {
+			break;
+		}
+
+		if (acceptedRecording->end > recording->begin) {
+			overlapping.append(acceptedRecording);
+		}
+	}
+
+	// the set of active recordings only changes at the beginning of a recording,
+	// so it's enough to check those points within the new recording
+
+	QDateTime lastCheckPoint;
+
+	for (int i = -1; i < overlapping.size(); ++i) {
+		QDateTime checkPoint = recording->begin;
+
+		if ((i >= 0) && (overlapping.at(i)->begin > checkPoint)) {
+			checkPoint = overlapping.at(i)->begin;
+		}
+
+		if (checkPoint == lastCheckPoint) {
+			continue;
+		}
+
+		lastCheckPoint = checkPoint;
+		QList<DvbSharedRecording> activeRecordings;
+		activeRecordings.append(recording);
+
+		foreach (const DvbSharedRecording &overlappingRecording, overlapping) {
+			if (overlappingRecording->begin > checkPoint) {
+				break;
+			}
+
+			if (overlappingRecording->end > checkPoint) {
+				activeRecordings.append(overlappingRecording);
+			}
+		}
+
+		if (!canAssignTuners(activeRecordings)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool DvbRecordingScheduler::canAssignTuners(
+	const QList<DvbSharedRecording> &activeRecordings) const
+{
+	// recordings on the same transponder form one group which needs one tuner
+
+	QList<DvbSharedChannel> groups;
+
+	foreach (const DvbSharedRecording &recording, activeRecordings) {
+		const DvbSharedChannel &channel = recording->channel;
+		bool found = false;
+
+		foreach (const DvbSharedChannel &groupChannel, groups) {
+			if ((groupChannel->source == channel->source) &&
+			    groupChannel->transponder.corresponds(channel->transponder)) {
+				found = true;
+				break;
+			}
+		}
+
+		if (!found) {
+			groups.append(channel);
+		}
+	}
+
+	if (groups.size() > tunerSources.size()) {
+		return false;
+	}
+
+	QList<QList<int> > groupTuners;
+
+	foreach (const DvbSharedChannel &groupChannel, groups) {
+		QList<int> tuners;
+
+		for (int i = 0; i < tunerSources.size(); ++i) {
+			if (tunerSources.at(i).contains(groupChannel->source)) {
+				tuners.append(i);
+			}
+		}
+
+		groupTuners.append(tuners);
+	}
+
+	// bipartite matching between groups and tuners (augmenting paths)
+
+	QVector<int> tunerGroups(tunerSources.size(), -1);
+
+	for (int group = 0; group < groups.size(); ++group) {
+		QVector<bool> visitedTuners(tunerSources.size(), false);
+
+		if (!assignTuner(group, groupTuners, tunerGroups, visitedTuners)) {
+			return false;
+		}
+	}
+
+	return true;
 }
 
+bool DvbRecordingScheduler::assignTuner(int group, const QList<QList<int> > &groupTuners,
+	QVector<int> &tunerGroups, QVector<bool> &visitedTuners) const
+{
+	foreach (int tuner, groupTuners.at(group)) {
+		if (visitedTuners.at(tuner)) {
+			continue;
+		}
+
+		visitedTuners[tuner] = true;
+
+		if ((tunerGroups.at(tuner) < 0) ||
+		    assignTuner(tunerGroups.at(tuner), groupTuners, tunerGroups, visitedTuners)) {
+			tunerGroups[tuner] = group;
+			return true;
+		}
+	}
+
+	return false;
+}
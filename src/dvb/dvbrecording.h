@@ -22,10 +22,15 @@
 #define DVBRECORDING_H
 
 #include <QDateTime>
+#include <QMap>
+#include <QPointer>
+#include <QRegularExpression>
+#include <QSet>
 #include <QTextStream>
 #include "dvbchannel.h"
 
 class DvbManager;
+class DvbMuxCapture;
 class DvbRecordingFile;
 class DvbEpgEntry;
 
@@ -33,7 +38,7 @@ class DvbRecording : public SharedData, public SqlKey
 {
 
 public:
-	DvbRecording() : repeat(0), status(Inactive) { disabled = false; }
+	DvbRecording() : repeat(0), priority(10), status(Inactive) { disabled = false; autoDisabled = false; }
 	~DvbRecording() { }
 
 	// checks that all variables are ok and updates 'end'
@@ -61,12 +66,46 @@ public:
 	int repeat; // (1 << 0) (monday) | (1 << 1) (tuesday) | ... | (1 << 6) (sunday)
 	int priority;
 	bool disabled;
+	bool autoDisabled; // disabled because of a conflict; re-enabled once it's resolved
 	Status status; // read-only
+	QString profile; // selects the recorded streams (empty = global profile)
 };
 
 typedef ExplicitlySharedDataPointer<const DvbRecording> DvbSharedRecording;
 Q_DECLARE_TYPEINFO(DvbSharedRecording, Q_MOVABLE_TYPE);
 
+// defined in dvbepg.h
+typedef ExplicitlySharedDataPointer<const DvbEpgEntry> DvbSharedEpgEntry;
+Q_DECLARE_TYPEINFO(DvbSharedEpgEntry, Q_MOVABLE_TYPE);
+
+// identifies equal recordings; an empty 'name' matches only an empty name
+
+class DvbRecordingSignature
+{
+public:
+	DvbRecordingSignature(const DvbSharedChannel &channel_, const QDateTime &begin_,
+		const QTime &duration_, const QString &name_ = QString()) : channel(channel_),
+		begin(begin_.toUTC()), duration(duration_), name(name_) { }
+	~DvbRecordingSignature() { }
+
+	bool operator==(const DvbRecordingSignature &other) const
+	{
+		return ((channel == other.channel) && (begin == other.begin) &&
+			(duration == other.duration) && (name == other.name));
+	}
+
+	friend uint qHash(const DvbRecordingSignature &signature)
+	{
+		return (qHash(signature.channel) ^ qHash(signature.begin) ^
+			qHash(signature.duration) ^ qHash(signature.name));
+	}
+
+	DvbSharedChannel channel;
+	QDateTime begin; // UTC
+	QTime duration;
+	QString name;
+};
+
 class DvbRecordingModel : public QObject, private SqlInterface
 {
 	Q_OBJECT
@@ -85,21 +124,26 @@ public:
 	void updateRecording(DvbSharedRecording recording, DvbRecording &modifiedRecording);
 	void removeRecording(DvbSharedRecording recording);
 	void addToUnwantedRecordings(DvbSharedRecording recording);
+	// has to be called when the recording regexes or their priorities change
+	void invalidateRecordingRegexes();
 	void findNewRecordings();
+	// removes recordings which only repeat another one (done asynchronously)
 	void removeDuplicates();
 	void executeActionAfterRecording(DvbRecording recording);
 	DvbRecording getCurrentRecording();
 	void setCurrentRecording(DvbRecording _currentRecording);
-	void disableLessImportant(DvbSharedRecording &recording1, DvbSharedRecording &recording2);
-	bool areInConflict(DvbSharedRecording recording1, DvbSharedRecording recording2);
-	bool isInConflictWithAll(DvbSharedRecording rec, QList<DvbSharedRecording> recList);
-	int getNumberOfLeastImportants(QList<DvbSharedRecording> recList);
-	DvbSharedRecording getLeastImportant(QList<DvbSharedRecording> recList);
-	void disableLeastImportants(QList<DvbSharedRecording> recList);
+	// disables the least important recordings which can't be recorded
+	// because there aren't enough tuners (the check is done asynchronously)
 	void disableConflicts();
+	// shared capture of the transponder of 'channel' (null if it can't be started)
+	QExplicitlySharedDataPointer<DvbMuxCapture> getMuxCapture(const DvbSharedChannel &channel);
+	// called for the present / following events of the eit (times in UTC)
+	void updateRunningStatus(const DvbSharedChannel &channel, int eventId,
+		const QDateTime &begin, int runningStatus, bool present);
 	int getSecondsUntilNextRecording() const;
 	bool isScanWhenIdle() const;
 	bool shouldWeScanChannels() const;
+	// called regularly; starts an incremental scan if the devices have been idle for a while
 	void scanChannels();
 
 signals:
@@ -109,22 +153,70 @@ signals:
 	void recordingUpdated(const DvbSharedRecording &recording);
 	void recordingRemoved(const DvbSharedRecording &recording);
 
+private slots:
+	void epgEntryChanged(const DvbSharedEpgEntry &entry);
+	void epgEntryRemoved(const DvbSharedEpgEntry &entry);
+
 private:
+	void customEvent(QEvent *event) override;
 	void timerEvent(QTimerEvent *event) override;
 
 	void bindToSqlQuery(SqlKey sqlKey, QSqlQuery &query, int index) const override;
 	bool insertFromSqlQuery(SqlKey sqlKey, const QSqlQuery &query, int index) override;
 	bool updateStatus(DvbRecording &recording);
-	bool existsSimilarRecording(DvbEpgEntry recording);
+	// removes the recording from the model and the database (see removeRecording())
+	void takeRecording(const DvbSharedRecording &recording);
+	void takeDuplicates();
+	bool existsSimilarRecording(const DvbEpgEntry &entry) const;
+	// maintains 'epgRecordings' (has to be called before the recording is modified)
+	void indexRecording(const DvbSharedRecording &recording);
+	void unindexRecording(const DvbSharedRecording &recording);
+	bool hasRecordingRegexes();
+	bool findRegexCandidates(QSet<DvbSharedEpgEntry> &candidates) const;
+	int findRecordingRegex(const QString &title) const;
+	void scheduleIfMatching(const DvbSharedEpgEntry &entry);
+	// queues the entries which may have been skipped because of the recording
+	void requeueSimilarEntries(const DvbRecording &recording);
+	void resolveConflicts();
+	void postDeferredEvent();
+	// (re)queues the next start / stop of the recording
+	void scheduleTransition(const DvbSharedRecording &recording);
+	void unscheduleTransition(const DvbSharedRecording &recording);
+	void armTransitionTimer();
 
 	DvbManager *manager;
 	QMap<SqlKey, DvbSharedRecording> recordings;
 	QList<DvbSharedRecording> unwantedRecordings;
+	QSet<DvbRecordingSignature> unwantedSignatures; // without name
+	// recordings of epg events by channel and epg begin (UTC)
+	QHash<DvbSharedChannel, QMultiMap<QDateTime, DvbSharedRecording> > epgRecordings;
+	int maxEpgDuration; // seconds, upper bound for the recordings in 'epgRecordings'
 	QMap<SqlKey, QExplicitlySharedDataPointer<DvbRecordingFile> > recordingFiles;
+	QList<QPointer<DvbMuxCapture> > muxCaptures;
 	bool hasPendingOperation;
 	DvbRecording currentRecording;
-};
 
-void delay(int seconds);
+	// compiled from DvbManager::getRecordingRegexList() (empty patterns are skipped)
+	QList<QRegularExpression> recordingRegexes;
+	QList<int> recordingRegexPriorities;
+	// the word each regex requires (empty = unknown) and whether it begins a word
+	// of the title; they are used to look up the candidates in the epg text index
+	QStringList recordingRegexWords;
+	QList<bool> recordingRegexWordStarts;
+	QRegularExpression combinedRecordingRegex; // only used to reject non-matching titles
+	bool recordingRegexesValid;
+	// added or updated epg entries which haven't been matched yet
+	QSet<DvbSharedEpgEntry> pendingEpgEntries;
+	bool deferredEventPending;
+	bool conflictCheckPending;
+	bool duplicateCheckPending;
+	// upcoming starts / stops ordered by time (UTC)
+	QMultiMap<QDateTime, DvbSharedRecording> transitions;
+	QHash<DvbSharedRecording, QDateTime> transitionTimes;
+	int transitionTimerId;
+	int idleTimerId; // see scanChannels()
+	QDateTime idleSince; // UTC, invalid while a live view or a recording is active
+	QDateTime lastIdleScan; // UTC
+};
 
 #endif /* DVBRECORDING_H */
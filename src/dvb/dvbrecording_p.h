@@ -21,14 +21,260 @@
 #ifndef DVBRECORDING_P_H
 #define DVBRECORDING_P_H
 
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QFile>
-#include <QTimer>
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include "../seekindex.h"
 #include "dvbchannel.h"
+#include "dvbrecording.h"
 #include "dvbsi.h"
 
 class DvbDevice;
+class DvbDeviceConfig;
 class DvbManager;
-class DvbRecording;
+
+// collects the recorded data in large aligned buffers and writes them
+// in a separate thread, so that a slow disk doesn't stall the demux
+
+class DvbRecordingWriter : public QThread
+{
+public:
+	DvbRecordingWriter();
+	~DvbRecordingWriter();
+
+	// the file descriptor is duplicated (the caller may close its file at any time);
+	// for direct io the file is opened again, so that the caller's file isn't affected
+	// 'end' (UTC) is used to estimate how much space should be preallocated
+	void open(int fd_, const QString &fileName_, const QDateTime &end_, bool directIo,
+		bool dropCache_);
+	// continues with another file; the previous file is completed (and closed) by
+	// the writer thread, so that the main thread doesn't have to wait
+	void switchFile(int fd_, const QString &fileName_);
+	// called from the main thread; data is dropped if the disk can't keep up
+	// 'size' has to be a multiple of 188 (whole packets)
+	void write(const char *data, int size);
+	void write(const QByteArray &data)
+	{
+		write(data.constData(), data.size());
+	}
+
+	// writes the remaining data and waits for the thread
+	void close();
+
+	// offset of the next packet in the file (dropped data isn't counted)
+	qint64 position() const
+	{
+		return writtenBytes;
+	}
+
+	// number of files which have been completed because of switchFile() since open()
+	int finishedFiles() const
+	{
+		return finishedFileCount.loadAcquire();
+	}
+
+private:
+	class Buffer
+	{
+	public:
+		char *data; // NULL = switch to 'fd' after the previous buffers
+		int size;
+		int fd;
+		QString fileName;
+	};
+
+	enum {
+		// multiple of the packet size and of the O_DIRECT alignment, so that
+		// a dropped buffer only contains whole packets
+		BufferSize = 188 * 4096 * 3,
+		BufferAlignment = 4096,
+		MaxQueuedBuffers = 16
+	};
+
+	void run() override;
+	Buffer allocateBuffer(); // mutex must be locked
+	void startFile(int fd_, const QString &fileName_);
+	void finishFile();
+	bool writeBuffer(const Buffer &buffer);
+	void preallocate(qint64 size);
+
+	QMutex mutex;
+	QWaitCondition bufferQueued;
+	QList<Buffer> queuedBuffers;
+	QList<Buffer> freeBuffers;
+	bool closing;
+
+	QAtomicInt finishedFileCount;
+
+	// only accessed by the main thread
+	Buffer currentBuffer;
+	QString currentFileName; // of 'currentBuffer'
+	qint64 writtenBytes;
+
+	// only accessed by the writer thread while it's running
+	int fd;
+	QString fileName;
+	bool directIoRequested;
+	bool directIo;
+	bool dropCache;
+	QDateTime end;
+	QElapsedTimer elapsedTimer;
+	qint64 offset;
+	qint64 advisedOffset;
+	qint64 syncedOffset; // writeback has been started up to this offset
+	qint64 allocatedSize;
+	bool preallocationFailed;
+
+	// statistics of the current file (protected by the mutex)
+	int droppedBuffers;
+	int writtenBuffers;
+	int maxQueueDepth;
+	qint64 totalLatency; // ms
+	qint64 maxLatency; // ms
+};
+
+// selects the streams of a recording, for example "audio=deu,eng;maxaudio=1;teletext=0"
+// keys: audio / subtitles (languages, "none" or empty = all), maxaudio, teletext (0 / 1)
+
+class DvbRecordingProfile
+{
+public:
+	DvbRecordingProfile() : maxAudioStreams(-1), subtitles(true), teletext(true) { }
+	explicit DvbRecordingProfile(const QString &profile);
+	~DvbRecordingProfile() { }
+
+	// the pcr pid is always included
+	QList<int> selectPids(const DvbPmtSection &pmtSection) const;
+
+	QStringList audioLanguages; // in order of preference
+	int maxAudioStreams; // -1 = unlimited
+	bool subtitles;
+	QStringList subtitleLanguages;
+	bool teletext;
+};
+
+// fixed-size ring of packets; the oldest packets are overwritten when it's full
+
+class DvbRecordingPacketRing
+{
+public:
+	DvbRecordingPacketRing() : capacity(0), begin(0), count(0) { }
+	~DvbRecordingPacketRing() { }
+
+	void reset(int maxSize); // bytes
+	void clear(); // also frees the memory
+
+	bool isEmpty() const
+	{
+		return (count == 0);
+	}
+
+	int size() const
+	{
+		return count;
+	}
+
+	// returns false if the oldest packet had to be dropped
+	bool append(const char packet[188]);
+	void writeTo(DvbRecordingWriter &writer) const;
+
+private:
+	QByteArray data;
+	int capacity; // packets
+	int begin;
+	int count;
+};
+
+class DvbRecordingFile;
+
+// a service which is extracted from a mux capture
+
+class DvbMuxSplitJob
+{
+public:
+	DvbMuxSplitJob() : transportStreamId(0), serviceId(0), pmtPid(0), begin(0), end(0) { }
+	~DvbMuxSplitJob() { }
+
+	QString fileName;
+	int transportStreamId;
+	int serviceId;
+	int pmtPid;
+	// pmt sections and the offsets in the mux file from which they are valid
+	// (ascending; the streams are selected again whenever the pmt changes)
+	QList<QPair<qint64, QByteArray> > pmtSections;
+	DvbRecordingProfile profile;
+	qint64 begin; // offsets in the mux file
+	qint64 end;
+};
+
+// records the whole transport stream of a transponder into one file
+// the recordings are extracted by DvbMuxSplitter when the last service is removed
+
+class DvbMuxCapture : public QObject, public QSharedData, private DvbPidFilter
+{
+	Q_OBJECT
+public:
+	DvbMuxCapture(DvbManager *manager_, const DvbSharedChannel &channel);
+	~DvbMuxCapture();
+
+	bool isValid() const
+	{
+		return ((device != NULL) && file.isOpen());
+	}
+
+	bool matches(const DvbSharedChannel &channel) const;
+
+	void addService(const DvbRecordingFile *recordingFile, const DvbSharedChannel &channel,
+		const DvbRecordingProfile &profile, const QString &fileName);
+	void updatePmt(const DvbRecordingFile *recordingFile, const QByteArray &pmtSectionData);
+	// the capture is finished after the last service has been removed
+	void removeService(const DvbRecordingFile *recordingFile);
+
+private slots:
+	void deviceStateChanged();
+
+private:
+	void processData(const char data[188]) override;
+	void finish(); // stops capturing and starts splitting
+
+	DvbManager *manager;
+	QString source;
+	DvbTransponder transponder;
+	DvbDevice *device;
+	QFile file;
+	DvbRecordingWriter writer; // its position() is used for the offsets of the jobs
+	QHash<const DvbRecordingFile *, DvbMuxSplitJob> activeJobs;
+	QList<DvbMuxSplitJob> finishedJobs;
+};
+
+// the splitter is a child of the recording model; it's interrupted when the model is
+// destroyed (the mux file is removed anyway, the recordings are left incomplete)
+
+class DvbMuxSplitter : public QThread
+{
+public:
+	DvbMuxSplitter(const QString &muxFileName_, const QList<DvbMuxSplitJob> &jobs_,
+		QObject *parent) : QThread(parent), muxFileName(muxFileName_), jobs(jobs_) { }
+
+	~DvbMuxSplitter()
+	{
+		requestInterruption();
+		wait();
+	}
+
+private:
+	void run() override;
+	void split(QFile &muxFile, const DvbMuxSplitJob &job);
+
+	QString muxFileName;
+	QList<DvbMuxSplitJob> jobs;
+};
 
 class DvbRecordingFile : private QObject, public QSharedData, private DvbPidFilter
 {
@@ -41,26 +287,99 @@ public:
 	bool start(DvbRecording &recording);
 	void stop();
 
+	// see DvbManager::isRecordingRunningStatus()
+	// the event is found by its begin (or as the first event running inside the
+	// recording) and then followed by its event id (the begin may change)
+	void updateRunningStatus(const DvbSharedChannel &channel_, int eventId_,
+		const QDateTime &begin, int runningStatus, bool present);
+
+	bool isEventRunning() const
+	{
+		return (eventState == EventRunning);
+	}
+
 private slots:
 	void deviceStateChanged();
 	void pmtSectionChanged(const QByteArray &pmtSectionData_);
-	void insertPatPmt();
+	void finishEvent();
 
 private:
+	enum EventState {
+		EventIgnored, // running status isn't used
+		EventUnknown, // recorded like without running status
+		EventWaiting, // the event hasn't started yet; nothing is written
+		EventRunning
+	};
+
 	void processData(const char data[188]) override;
+	void insertPatPmt();
+	void updateSeekIndexStreams();
+
+	QString segmentFileName(int number) const;
+	void startSegment(); // the previous segment is completed asynchronously
+	void finishSegment(bool lastSegment);
+	void writePlaylist(bool complete);
 
 	DvbManager *manager;
 	DvbSharedChannel channel;
 	QFile file;
-	QList<QByteArray> buffers;
+	DvbRecordingWriter writer;
+	SeekIndexWriter seekIndex;
+	DvbRecordingProfile profile;
+	bool muxMode;
+	QExplicitlySharedDataPointer<DvbMuxCapture> muxCapture;
+	// segmented output: the segments start at random access points and
+	// are listed in a playlist ("<name>.m3u8") once they are complete
+	int segmentDuration; // ms, 0 = one file
+	QString segmentBaseName; // path without extension
+	int segmentNumber;
+	bool segmentsFailed; // the current segment is continued until the end
+	bool playlistPending; // a segment hasn't been completed by the writer yet
+	QStringList segmentFileNames; // complete segments
+	QList<int> segmentDurations; // ms
+	EventState eventState;
+	QDateTime eventBegin; // UTC, invalid = the first event running inside the recording
+	int eventId; // -1 = the event hasn't been found yet
+	QDateTime recordingBegin; // UTC
+	QDateTime recordingEnd; // UTC
+	bool finished; // the event has ended before the recording
+	// packets received before the pmt (bounded by size and time)
+	DvbRecordingPacketRing prePmtPackets;
+	QElapsedTimer prePmtTimer;
+	int prePmtTimeBudget; // ms
+	int droppedPrePmtPackets;
 	DvbDevice *device;
 	QList<int> pids;
 	DvbPmtFilter pmtFilter;
 	QByteArray pmtSectionData;
 	DvbSectionGenerator patGenerator;
 	DvbSectionGenerator pmtGenerator;
-	QTimer patPmtTimer;
+	DvbPatPmtRepetition patPmtRepetition;
 	bool pmtValid;
 };
 
+// decides which recordings can't be recorded because there aren't enough tuners
+// recordings on the same transponder share a tuner
+
+class DvbRecordingScheduler
+{
+public:
+	explicit DvbRecordingScheduler(const QList<DvbDeviceConfig> &deviceConfigs);
+	~DvbRecordingScheduler() { }
+
+	// returns the recordings which should be disabled; running recordings and
+	// recordings with a higher priority are kept in preference
+	QList<DvbSharedRecording> findConflicts(QList<DvbSharedRecording> recordings) const;
+
+private:
+	bool isSupported(const DvbSharedRecording &recording) const;
+	bool fits(const DvbSharedRecording &recording,
+		const QList<DvbSharedRecording> &accepted) const;
+	bool canAssignTuners(const QList<DvbSharedRecording> &activeRecordings) const;
+	bool assignTuner(int group, const QList<QList<int> > &groupTuners,
+		QVector<int> &tunerGroups, QVector<bool> &visitedTuners) const;
+
+	QList<QStringList> tunerSources; // one entry per tuner
+};
+
 #endif /* DVBRECORDING_P_H */
@@ -466,6 +466,17 @@ DvbRecordingEditor::DvbRecordingEditor(DvbManager *manager_, const DvbSharedReco
 	}
 
 	gridLayout->addLayout(dayLayout, 6, 1);
+
+	profileEdit = new QLineEdit(widget);
+	profileEdit->setPlaceholderText(manager->getRecordingProfile());
+	profileEdit->setToolTip(i18nc("@info:tooltip recording",
+		"Selects the recorded streams, for example \"audio=deu,eng;maxaudio=1;"
+		"subtitles=none;teletext=0\".\nLeave empty to use the global setting."));
+	gridLayout->addWidget(profileEdit, 7, 1);
+
+	label = new QLabel(i18nc("@label recording", "Streams:"), widget);
+	label->setBuddy(profileEdit);
+	gridLayout->addWidget(label, 7, 0);
 	mainLayout->addWidget(widget);
 
 	if (recording.isValid()) {
@@ -473,6 +484,7 @@ DvbRecordingEditor::DvbRecordingEditor(DvbManager *manager_, const DvbSharedReco
 		channelBox->setCurrentIndex(channelModel->find(recording->channel).row());
 		beginEdit->setDateTime(recording->begin.toLocalTime());
 		durationEdit->setTime(recording->duration);
+		profileEdit->setText(recording->profile);
 
 		for (int i = 0; i < 7; ++i) {
 			if ((recording->repeat & (1 << i)) != 0) {
@@ -488,6 +500,7 @@ DvbRecordingEditor::DvbRecordingEditor(DvbManager *manager_, const DvbSharedReco
 			nameEdit->setEnabled(false);
 			channelBox->setEnabled(false);
 			beginEdit->setEnabled(false);
+			profileEdit->setEnabled(false);
 			break;
 		}
 	} else {
@@ -564,6 +577,7 @@ void DvbRecordingEditor::accept()
 		manager->getChannelModel()->findChannelByName(channelBox->currentText());
 	newRecording.begin = beginEdit->dateTime().toUTC();
 	newRecording.duration = durationEdit->time();
+	newRecording.profile = profileEdit->text().trimmed();
 
 	for (int i = 0; i < 7; ++i) {
 		if (dayCheckBoxes[i]->isChecked()) {
@@ -142,6 +142,7 @@ private:
 	DurationEdit *durationEdit;
 	DateTimeEdit *endEdit;
 	QCheckBox *dayCheckBoxes[7];
+	QLineEdit *profileEdit;
 	QDialogButtonBox *buttonBox;
 };
 
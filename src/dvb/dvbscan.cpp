@@ -20,11 +20,17 @@
 
 #include "../log.h"
 
+#include <KConfigGroup>
+#include <KSharedConfig>
 #include <QBitArray>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QVector>
 #include <stdint.h>
+#include <string.h>
 
 #include "dvbdevice.h"
+#include "dvbmanager.h"
 #include "dvbscan.h"
 #include "dvbsi.h"
 
@@ -57,7 +63,8 @@ public:
 class DvbScanFilter : public DvbSectionFilter, QObject
 {
 public:
-	DvbScanFilter(DvbScan *scan_, bool useOtherNit_) : scan(scan_), pid(-1), useOtherNit(useOtherNit_) { }
+	DvbScanFilter(DvbScan *scan_, bool useOtherNit_) : scan(scan_), pid(-1), timerId(0),
+		firstSectionTime(-1), useOtherNit(useOtherNit_) { }
 
 	~DvbScanFilter()
 	{
@@ -82,6 +89,7 @@ private:
 	bool isFinished();
 	void processSection(const char *data, int size) override;
 	void timerEvent(QTimerEvent *) override;
+	void restartTimer();
 
 	DvbScan *scan;
 
@@ -89,6 +97,10 @@ private:
 	DvbScan::FilterType type;
 	QVector<sectCheck> multipleSections;
 	int timerId;
+	QElapsedTimer elapsedTimer;
+	qint64 firstSectionTime; // ms, -1 = no section received yet
+	int firstSectionId; // table id, table id extension and section number
+	int repetitions; // of the first section
 	bool useOtherNit;
 };
 
@@ -99,22 +111,26 @@ bool DvbScanFilter::startFilter(int pid_, DvbScan::FilterType type_)
 	pid = pid_;
 	type = type_;
 	multipleSections.clear();
+	firstSectionTime = -1;
+	repetitions = 0;
 
 	if (!scan->device->addSectionFilter(pid, this)) {
 		pid = -1;
 		return false;
 	}
 
-	// FIXME check timings
-	if (type != DvbScan::NitFilter) {
-		timerId = startTimer(5000);
-	} else {
-		timerId = startTimer(20000);
-	}
-
+	elapsedTimer.start();
+	timerId = startTimer(scan->owner->filterTimeout(type));
 	return true;
 }
 
+void DvbScanFilter::restartTimer()
+{
+	// the timeout counts from the last new section
+	killTimer(timerId);
+	timerId = startTimer(scan->owner->filterTimeout(type));
+}
+
 void DvbScanFilter::stopFilter()
 {
 	if (pid != -1) {
@@ -163,16 +179,38 @@ bool DvbScanFilter::checkMultipleSection(const DvbStandardSection &section)
 		}
 	}
 
+	int sectionId = ((section.tableId() << 24) ^ (section.tableIdExtension() << 8) ^
+		section.sectionNumber());
+
+	if (firstSectionTime < 0) {
+		// the time until the first section is a lower bound for the repetition rate
+		firstSectionTime = elapsedTimer.elapsed();
+		firstSectionId = sectionId;
+		scan->owner->addRepetitionTime(type, int(firstSectionTime));
+	} else if (sectionId == firstSectionId) {
+		qint64 time = elapsedTimer.elapsed();
+		scan->owner->addRepetitionTime(type, int(time - firstSectionTime));
+		firstSectionTime = time;
+		++repetitions;
+	}
+
 	if (check->testBit(section.sectionNumber())) {
 		return false;
 	}
 
 	check->setBit(section.sectionNumber());
+	restartTimer();
 	return true;
 }
 
 bool DvbScanFilter::isFinished()
 {
+	if (repetitions >= 2) {
+		// the missing sections haven't been broadcast for two cycles
+		qCDebug(logDvb, "Incomplete table; type = %d, PID = %d", type, pid);
+		return true;
+	}
+
 	for (int i = 0; i < multipleSections.size(); i++) {
 		if (multipleSections[i].check.count(false) != 0)
 			return false;
@@ -192,7 +230,7 @@ void DvbScanFilter::processSection(const char *data, int size)
 
 		if (!checkMultipleSection(patSection)) {
 			// already read this part
-			return;
+			break;
 		}
 
 		scan->processPat(patSection);
@@ -207,7 +245,7 @@ void DvbScanFilter::processSection(const char *data, int size)
 
 		if (!checkMultipleSection(pmtSection)) {
 			// already read this part
-			return;
+			break;
 		}
 
 		scan->processPmt(pmtSection, pid);
@@ -226,7 +264,7 @@ void DvbScanFilter::processSection(const char *data, int size)
 
 		if (!checkMultipleSection(sdtSection)) {
 			// already read this part
-			return;
+			break;
 		}
 
 		scan->processSdt(sdtSection);
@@ -243,7 +281,7 @@ void DvbScanFilter::processSection(const char *data, int size)
 
 		if (!checkMultipleSection(vctSection)) {
 			// already read this part
-			return;
+			break;
 		}
 
 		scan->processVct(vctSection);
@@ -263,7 +301,7 @@ void DvbScanFilter::processSection(const char *data, int size)
 
 		if (!checkMultipleSection(nitSection)) {
 			// already read this part
-			return;
+			break;
 		}
 
 		scan->processNit(nitSection);
@@ -281,26 +319,57 @@ void DvbScanFilter::timerEvent(QTimerEvent *)
 	scan->filterFinished(this);
 }
 
+bool DvbTransponderVersions::fromString(const QString &string)
+{
+	QStringList list = string.split(QLatin1Char(','));
+
+	if (list.size() != 3) {
+		return false;
+	}
+
+	bool patOk;
+	bool sdtOk;
+	bool nitOk;
+	patVersion = list.at(0).toInt(&patOk);
+	sdtVersion = list.at(1).toInt(&sdtOk);
+	nitVersion = list.at(2).toInt(&nitOk);
+	return (patOk && sdtOk && nitOk);
+}
+
+QString DvbTransponderVersions::toString() const
+{
+	return QString(QLatin1String("%1,%2,%3")).arg(patVersion).arg(sdtVersion).arg(nitVersion);
+}
+
 DvbScan::DvbScan(DvbDevice *device_, const QString &source_, const DvbTransponder &transponder_, bool useOtherNit_) :
 	device(device_), source(source_), transponder(transponder_), isLive(true), isAuto(false), useOtherNit(useOtherNit_),
-	transponderIndex(-1), state(ScanPat), patIndex(0), activeFilters(0)
+	incremental(false), transponderIndex(-1), currentIndex(-1), idle(false), owner(this),
+	listedTransponders(0), nitRead(false), nitBaseline(false), versionsChecked(false),
+	tablesChanged(true), state(ScanPat), patIndex(0), activeFilters(0)
 {
 	qCDebug(logDvb, "Use other NIT is %s", useOtherNit ? "enabled" : "disabled");
+	memset(repetitionTimes, 0, sizeof(repetitionTimes));
 }
 
 DvbScan::DvbScan(DvbDevice *device_, const QString &source_,
 	const QList<DvbTransponder> &transponders_, bool useOtherNit_) : device(device_), source(source_),
-	isLive(false), isAuto(false), useOtherNit(useOtherNit_), transponders(transponders_), transponderIndex(0),
+	isLive(false), isAuto(false), useOtherNit(useOtherNit_), incremental(false), transponders(transponders_),
+	transponderIndex(0), currentIndex(-1), idle(false), owner(this), listedTransponders(0),
+	nitRead(false), nitBaseline(false), versionsChecked(false), tablesChanged(true),
 	state(ScanTune), patIndex(0), activeFilters(0)
 {
 	qCDebug(logDvb, "Use other NIT is %s", useOtherNit ? "enabled" : "disabled");
+	memset(repetitionTimes, 0, sizeof(repetitionTimes));
 }
 
 DvbScan::DvbScan(DvbDevice *device_, const QString &source_, const QString &autoScanSource, bool useOtherNit_) :
-	device(device_), source(source_), isLive(false), isAuto(true), useOtherNit(useOtherNit_), transponderIndex(0),
-	state(ScanTune), patIndex(0), activeFilters(0)
+	device(device_), source(source_), isLive(false), isAuto(true), useOtherNit(useOtherNit_),
+	incremental(false), transponderIndex(0), currentIndex(-1), idle(false), owner(this),
+	listedTransponders(0), nitRead(false), nitBaseline(false), versionsChecked(false),
+	tablesChanged(true), state(ScanTune), patIndex(0), activeFilters(0)
 {
 	qCDebug(logDvb, "Use other NIT is %s", useOtherNit ? "enabled" : "disabled");
+	memset(repetitionTimes, 0, sizeof(repetitionTimes));
 
 	// Seek for DVB-T transponders
 
@@ -648,22 +717,74 @@ DvbScan::DvbScan(DvbDevice *device_, const QString &source_, const QString &auto
 	}
 }
 
+DvbScan::DvbScan(DvbScan *owner_, DvbDevice *device_) : device(device_),
+	source(owner_->source), isLive(false), isAuto(owner_->isAuto),
+	useOtherNit(owner_->useOtherNit), incremental(owner_->incremental), transponderIndex(-1),
+	currentIndex(-1), idle(false), owner(owner_), listedTransponders(0), nitRead(false),
+	nitBaseline(false), versionsChecked(false), tablesChanged(true), state(ScanTune), patIndex(0),
+	activeFilters(0)
+{
+	memset(repetitionTimes, 0, sizeof(repetitionTimes));
+}
+
+DvbScan::DvbScan(DvbDevice *device_, const QString &source_,
+	const QList<DvbTransponder> &transponders_,
+	const QHash<QString, DvbTransponderVersions> &knownVersions_) : device(device_),
+	source(source_), isLive(false), isAuto(false), useOtherNit(false), incremental(true),
+	transponders(transponders_), transponderIndex(0), currentIndex(-1), idle(false), owner(this),
+	knownVersions(knownVersions_), listedTransponders(transponders_.size()), nitRead(false),
+	nitBaseline(false), versionsChecked(false), tablesChanged(true), state(ScanTune), patIndex(0),
+	activeFilters(0)
+{
+	memset(repetitionTimes, 0, sizeof(repetitionTimes));
+}
+
 DvbScan::~DvbScan()
 {
+	if (!isLive && (device != NULL)) {
+		device->setCarrierCheck(false);
+	}
+
+	qDeleteAll(otherScans);
 	qDeleteAll(filters);
 }
 
+void DvbScan::addDevice(DvbDevice *device_)
+{
+	Q_ASSERT(!isLive && (owner == this));
+	// a released device only stops its own part of the scan (see deviceStateChanged())
+	otherScans.append(new DvbScan(this, device_));
+}
+
 void DvbScan::start()
 {
 	connect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+
+	if (!isLive) {
+		// don't wait for the tuning timeout on dead transponders
+		device->setCarrierCheck(true);
+	}
+
 	updateState();
+
+	foreach (DvbScan *otherScan, otherScans) {
+		otherScan->start();
+	}
 }
 
 void DvbScan::deviceStateChanged()
 {
 	if (device->getDeviceState() == DvbDevice::DeviceReleased) {
-		qCWarning(logDvb, "Device was released. Stopping scan");
-		emit scanFinished();
+		if (isLive) {
+			qCWarning(logDvb, "Device was released. Stopping scan");
+			emit scanFinished();
+			return;
+		}
+
+		// the device belongs to somebody else now (for example a recording);
+		// the other devices continue the scan
+		qCWarning(logDvb, "Device was released. Continuing scan with the other devices");
+		dropDevice();
 		return;
 	}
 
@@ -687,7 +808,8 @@ bool DvbScan::startFilter(int pid, FilterType type)
 		}
 
 		Q_ASSERT(false);
-	} else if (activeFilters < 10) {
+	} else if (activeFilters < 32) {
+		// all pmts are read concurrently (as far as the demux allows)
 		DvbScanFilter *filter = new DvbScanFilter(this, useOtherNit);
 
 		if (!filter->startFilter(pid, type)) {
@@ -718,11 +840,13 @@ void DvbScan::updateState()
 		    }
 			// fall through
 		case ScanNit: {
-			if (!isLive && !isAuto &&
+			if (!isLive && !isAuto && (!incremental || !owner->nitRead) &&
 			    (transponder.getTransmissionType() != DvbTransponderBase::Atsc)) {
 				if (!startFilter(0x10, NitFilter)) {
 					return;
 				}
+
+				owner->nitRead = true;
 			}
 
 			state = ScanSdt;
@@ -743,7 +867,33 @@ void DvbScan::updateState()
 		    }
 			// fall through
 		case ScanPmt: {
-			while (patIndex < patEntries.size()) {
+			if (incremental && !versionsChecked) {
+				// the versions of the first sections are sufficient
+				if (((versions.patVersion < 0) || (versions.sdtVersion < 0)) &&
+				    (activeFilters != 0)) {
+					return;
+				}
+
+				DvbTransponderVersions oldVersions =
+					owner->knownVersions.value(transponder.toString());
+
+				if (oldVersions.patVersion >= 0) {
+					tablesChanged = !versions.matches(oldVersions);
+				} else {
+					// newly announced by the nit (unless the versions are unknown
+					// because this is the first incremental scan)
+					tablesChanged = (!owner->nitBaseline ||
+						(currentIndex < owner->listedTransponders));
+				}
+
+				versionsChecked = true;
+
+				if (!tablesChanged) {
+					qCDebug(logDvb, "Tables unchanged; skipping the PMTs");
+				}
+			}
+
+			while (tablesChanged && (patIndex < patEntries.size())) {
 				if (!startFilter(patEntries.at(patIndex).pid, PmtFilter)) {
 					return;
 				}
@@ -777,7 +927,20 @@ void DvbScan::updateState()
 			}
 
 			if (!channels.isEmpty()) {
-				emit foundChannels(channels);
+				owner->addChannels(channels);
+			}
+
+			if (incremental) {
+				QList<int> serviceIds;
+
+				foreach (const DvbPatEntry &patEntry, patEntries) {
+					serviceIds.append(patEntry.programNumber);
+				}
+
+				if (versions.patVersion >= 0) {
+					emit owner->transponderScanned(transponder, versions, tablesChanged,
+						serviceIds);
+				}
 			}
 
 			if (isLive) {
@@ -790,23 +953,32 @@ void DvbScan::updateState()
 			patIndex = 0;
 			sdtEntries.clear();
 			channels.clear();
+			versions = DvbTransponderVersions();
+			versionsChecked = false;
+			tablesChanged = true;
 
 			state = ScanTune;
 		    }
 			// fall through
 		case ScanTune: {
-			if (transponders.size() > 0) {
-				emit scanProgress((100 * transponderIndex) / transponders.size());
+			// the devices take the transponders from the list of the owner
+			int size = owner->transponders.size();
+
+			if (size > 0) {
+				emit owner->scanProgress((100 * owner->transponderIndex) / size);
 			}
 
-			qCDebug(logDvb, "Transponder %d/%d", transponderIndex, transponders.size());
-			if (transponderIndex >= transponders.size()) {
-				emit scanFinished();
+			qCDebug(logDvb, "Transponder %d/%d", owner->transponderIndex, size);
+			if (owner->transponderIndex >= size) {
+				// the nit of another device may still add transponders
+				idle = true;
+				owner->checkFinished();
 				return;
 			}
 
-			transponder = transponders.at(transponderIndex);
-			++transponderIndex;
+			currentIndex = owner->transponderIndex;
+			transponder = owner->transponders.at(currentIndex);
+			++owner->transponderIndex;
 
 			state = ScanTuning;
 
@@ -827,7 +999,7 @@ void DvbScan::updateState()
 
 			case DvbDevice::DeviceTuned:
 				if (isAuto) {
-					transponders[transponderIndex - 1] =
+					owner->transponders[currentIndex] =
 						device->getAutoTransponder();
 				}
 
@@ -847,6 +1019,7 @@ void DvbScan::updateState()
 void DvbScan::processPat(const DvbPatSection &section)
 {
 	transportStreamId = section.transportStreamId();
+	versions.patVersion = section.versionNumber();
 
 	for (DvbPatSectionEntry entry = section.entries(); entry.isValid(); entry.advance()) {
 		if (entry.programNumber() != 0x0) {
@@ -899,6 +1072,8 @@ void DvbScan::processPmt(const DvbPmtSection &section, int pid)
 
 void DvbScan::processSdt(const DvbSdtSection &section)
 {
+	versions.sdtVersion = section.versionNumber();
+
 	for (DvbSdtSectionEntry entry = section.entries(); entry.isValid(); entry.advance()) {
 		DvbSdtEntry sdtEntry(entry.serviceId(), section.originalNetworkId(),
 				     entry.isScrambled());
@@ -926,6 +1101,8 @@ void DvbScan::processSdt(const DvbSdtSection &section)
 
 void DvbScan::processVct(const AtscVctSection &section)
 {
+	versions.sdtVersion = section.versionNumber();
+
 	AtscVctSectionEntry entry = section.entries();
 	int entryCount = section.entryCount();
 
@@ -976,6 +1153,24 @@ void DvbScan::processVct(const AtscVctSection &section)
 
 void DvbScan::processNit(const DvbNitSection &section)
 {
+	if (section.tableId() == 0x40) {
+		versions.nitVersion = section.versionNumber();
+
+		if (incremental) {
+			int knownVersion = owner->knownVersions.value(transponder.toString()).nitVersion;
+
+			if (section.versionNumber() == knownVersion) {
+				// the announced transponders are already known
+				return;
+			}
+
+			if (knownVersion < 0) {
+				// first incremental scan; the other transponders are only recorded
+				owner->nitBaseline = true;
+			}
+		}
+	}
+
 	for (DvbNitSectionEntry entry = section.entries(); entry.isValid(); entry.advance()) {
 		for (DvbDescriptor descriptor = entry.descriptors(); descriptor.isValid();
 		     descriptor.advance()) {
@@ -1347,31 +1542,127 @@ void DvbScan::processNitDescriptor(const DvbDescriptor &descriptor)
 				isdbTTransponder->segmentCount[i] = 15;
 			}
 
-			bool duplicate = false;
-
-			foreach (const DvbTransponder &existingTransponder, transponders) {
-				if (existingTransponder.corresponds(newTransponder)) {
-					duplicate = true;
-					break;
-				}
-			}
-			if (duplicate)
-				continue;
-
-			transponders.append(newTransponder);
-			qCDebug(logDvb, "Added transponder: %.2f MHz", isdbTTransponder->frequency / 1000000.);
+			owner->addTransponder(newTransponder);
+			qCDebug(logDvb, "Found transponder: %.2f MHz", isdbTTransponder->frequency / 1000000.);
 		}
 		return;
 	}
 
 
 	// New transponder was found. Add it
+	owner->addTransponder(newTransponder);
+}
+
+void DvbScan::addChannels(const QList<DvbPreviewChannel> &newChannels)
+{
+	// a service can be found by several devices (for example if the nit
+	// lists a transponder with a slightly different frequency)
+	QList<DvbPreviewChannel> uniqueChannels;
+
+	foreach (const DvbPreviewChannel &channel, newChannels) {
+		qint64 key = ((qint64(channel.networkId & 0xffff) << 32) |
+			(qint64(channel.transportStreamId & 0xffff) << 16) | channel.serviceId);
+
+		if (!foundServices.contains(key)) {
+			foundServices.insert(key);
+			uniqueChannels.append(channel);
+		}
+	}
+
+	if (!uniqueChannels.isEmpty()) {
+		emit foundChannels(uniqueChannels);
+	}
+}
+
+void DvbScan::addTransponder(const DvbTransponder &newTransponder)
+{
 	foreach (const DvbTransponder &existingTransponder, transponders) {
 		if (existingTransponder.corresponds(newTransponder))
 			return;
 	}
 
 	transponders.append(newTransponder);
+	wakeUp();
+}
+
+void DvbScan::wakeUp()
+{
+	// wake up the devices which have run out of transponders
+	if (idle && (device != NULL)) {
+		idle = false;
+		updateState();
+	}
+
+	foreach (DvbScan *otherScan, otherScans) {
+		if (otherScan->idle && (otherScan->device != NULL)) {
+			otherScan->idle = false;
+			otherScan->updateState();
+		}
+	}
+}
+
+void DvbScan::dropDevice()
+{
+	disconnect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+
+	foreach (DvbScanFilter *filter, filters) {
+		filter->stopFilter();
+	}
+
+	activeFilters = 0;
+	device = NULL;
+
+	if (!idle && (state != ScanTune)) {
+		// the interrupted transponder is scanned again by another device
+		owner->transponders.append(owner->transponders.at(currentIndex));
+	}
+
+	patEntries.clear();
+	patIndex = 0;
+	sdtEntries.clear();
+	channels.clear();
+	versions = DvbTransponderVersions();
+	versionsChecked = false;
+	tablesChanged = true;
+	state = ScanTune;
+	idle = true;
+
+	owner->wakeUp();
+	owner->checkFinished();
+}
+
+void DvbScan::addRepetitionTime(FilterType type, int time)
+{
+	if (repetitionTimes[type] < time) {
+		repetitionTimes[type] = time;
+	}
+}
+
+int DvbScan::filterTimeout(FilterType type) const
+{
+	// upper limits (the nit may be repeated every 10 seconds)
+	int maxTimeout = ((type != NitFilter) ? 5000 : 20000);
+
+	if (repetitionTimes[type] == 0) {
+		return maxTimeout;
+	}
+
+	return qBound(1000, (2 * repetitionTimes[type]) + 500, maxTimeout);
+}
+
+void DvbScan::checkFinished()
+{
+	if (!idle) {
+		return;
+	}
+
+	foreach (DvbScan *otherScan, otherScans) {
+		if (!otherScan->idle) {
+			return;
+		}
+	}
+
+	emit scanFinished();
 }
 
 void DvbScan::filterFinished(DvbScanFilter *filter)
@@ -1380,3 +1671,222 @@ void DvbScan::filterFinished(DvbScanFilter *filter)
 	--activeFilters;
 	updateState();
 }
+
+DvbIncrementalScan::DvbIncrementalScan(DvbManager *manager_, QObject *parent) : QObject(parent),
+	manager(manager_), device(NULL), scan(NULL)
+{
+}
+
+DvbIncrementalScan::~DvbIncrementalScan()
+{
+	stopScan();
+}
+
+void DvbIncrementalScan::start()
+{
+	foreach (const DvbSharedChannel &channel, manager->getChannelModel()->getChannels()) {
+		QList<DvbTransponder> &channelTransponders = sourceTransponders[channel->source];
+		bool found = false;
+
+		foreach (const DvbTransponder &transponder, channelTransponders) {
+			if (transponder.corresponds(channel->transponder)) {
+				found = true;
+				break;
+			}
+		}
+
+		if (!found) {
+			channelTransponders.append(channel->transponder);
+		}
+	}
+
+	startNextSource();
+}
+
+void DvbIncrementalScan::startNextSource()
+{
+	stopScan();
+
+	while (!sourceTransponders.isEmpty()) {
+		source = sourceTransponders.constBegin().key();
+		transponders = sourceTransponders.take(source);
+		device = manager->requestExclusiveDevice(source);
+
+		if (device == NULL) {
+			qCWarning(logDvb, "No idle device for rescanning %s", qPrintable(source));
+			continue;
+		}
+
+		QHash<QString, DvbTransponderVersions> knownVersions;
+		KConfigGroup group =
+			KSharedConfig::openConfig()->group("DVB Scan Versions").group(source);
+
+		foreach (const QString &key, group.keyList()) {
+			DvbTransponderVersions versions;
+
+			if (versions.fromString(group.readEntry(key, QString()))) {
+				knownVersions.insert(key, versions);
+			}
+		}
+
+		qCDebug(logDvb, "Rescanning %d transponders of %s", transponders.size(),
+			qPrintable(source));
+		scan = new DvbScan(device, source, transponders, knownVersions);
+		connect(scan, SIGNAL(foundChannels(QList<DvbPreviewChannel>)),
+			this, SLOT(foundChannels(QList<DvbPreviewChannel>)));
+		connect(scan, SIGNAL(transponderScanned(DvbTransponder,DvbTransponderVersions,bool,QList<int>)),
+			this, SLOT(transponderScanned(DvbTransponder,DvbTransponderVersions,bool,QList<int>)));
+		// the scan is deleted in the slot, so the signal has to be queued
+		connect(scan, SIGNAL(scanFinished()), this, SLOT(scanFinished()), Qt::QueuedConnection);
+		connect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+		scan->start();
+		return;
+	}
+
+	qCDebug(logDvb, "Rescan finished");
+	deleteLater();
+}
+
+void DvbIncrementalScan::stopScan()
+{
+	delete scan;
+	scan = NULL;
+	pendingChannels.clear();
+
+	if (device != NULL) {
+		disconnect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+		manager->releaseDevice(device, DvbManager::Exclusive);
+		device = NULL;
+	}
+}
+
+void DvbIncrementalScan::removeMissingChannels(const DvbTransponder &transponder,
+	const QList<int> &serviceIds)
+{
+	// part-time services regularly disappear from the pat (for example at night),
+	// so a channel is only removed if it has been missing for a while
+	static const int minMissingScans = 3;
+	static const qint64 minMissingSecs = (7 * 24 * 3600);
+
+	DvbChannelModel *channelModel = manager->getChannelModel();
+	KConfigGroup missingGroup =
+		KSharedConfig::openConfig()->group("DVB Scan Missing").group(source);
+	QDateTime currentDateTime = QDateTime::currentDateTime().toUTC();
+
+	foreach (const DvbSharedChannel &channel, channelModel->getChannels()) {
+		if ((channel->source != source) || !channel->transponder.corresponds(transponder)) {
+			continue;
+		}
+
+		QString key = transponder.toString() + QLatin1Char('|') +
+			QString::number(channel->serviceId);
+
+		if (serviceIds.contains(channel->serviceId)) {
+			if (missingGroup.hasKey(key)) {
+				missingGroup.deleteEntry(key);
+			}
+
+			continue;
+		}
+
+		// "<number of scans>,<first scan without the service (UTC)>"
+		QStringList missing = missingGroup.readEntry(key, QString()).split(QLatin1Char(','));
+		int missingScans = 1;
+		QDateTime firstMissing = currentDateTime;
+
+		if (missing.size() == 2) {
+			missingScans = (missing.at(0).toInt() + 1);
+			firstMissing = QDateTime::fromString(missing.at(1), Qt::ISODate);
+			firstMissing.setTimeSpec(Qt::UTC);
+
+			if (!firstMissing.isValid()) {
+				firstMissing = currentDateTime;
+			}
+		}
+
+		if ((missingScans < minMissingScans) ||
+		    (firstMissing.secsTo(currentDateTime) < minMissingSecs)) {
+			qCDebug(logDvb, "Channel %s is missing in the PAT (%d scans)",
+				qPrintable(channel->name), missingScans);
+			missingGroup.writeEntry(key, QString(QLatin1String("%1,%2")).arg(missingScans).
+				arg(firstMissing.toString(Qt::ISODate)));
+			continue;
+		}
+
+		missingGroup.deleteEntry(key);
+		qCInfo(logDvb, "Removing channel %s which isn't broadcast anymore",
+			qPrintable(channel->name));
+		channelModel->removeChannel(channel);
+	}
+}
+
+void DvbIncrementalScan::deviceStateChanged()
+{
+	if (device->getDeviceState() == DvbDevice::DeviceReleased) {
+		// the device belongs to somebody else now (for example a recording);
+		// the scan stops itself, but the device mustn't be released again
+		disconnect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+		device = NULL;
+	}
+}
+
+void DvbIncrementalScan::foundChannels(const QList<DvbPreviewChannel> &channels)
+{
+	// the channels are handled together with the pat of the transponder
+	pendingChannels.append(channels);
+}
+
+void DvbIncrementalScan::transponderScanned(const DvbTransponder &transponder,
+	const DvbTransponderVersions &versions, bool changed, const QList<int> &serviceIds)
+{
+	QString key = transponder.toString();
+	KSharedConfig::Ptr config = KSharedConfig::openConfig();
+	KConfigGroup versionGroup = config->group("DVB Scan Versions").group(source);
+	KConfigGroup serviceGroup = config->group("DVB Scan Services").group(source);
+
+	if (changed) {
+		DvbChannelModel *channelModel = manager->getChannelModel();
+		QList<int> knownServiceIds = serviceGroup.readEntry(key, QList<int>());
+		bool listed = false;
+
+		foreach (const DvbTransponder &it, transponders) {
+			if (it.corresponds(transponder)) {
+				listed = true;
+				break;
+			}
+		}
+
+		// services which haven't been in the channel list before are only added if
+		// they are new (the user may have left them out deliberately)
+		bool addNewServices = (serviceGroup.hasKey(key) || !listed);
+
+		foreach (const DvbPreviewChannel &channel, pendingChannels) {
+			DvbChannel newChannel(channel);
+
+			if (channelModel->findChannelById(newChannel).isValid() ||
+			    (addNewServices && !knownServiceIds.contains(channel.serviceId))) {
+				// existing channels are updated (the name and the number are kept)
+				channelModel->addChannel(newChannel);
+			}
+		}
+
+	}
+
+	if (!serviceIds.isEmpty()) {
+		removeMissingChannels(transponder, serviceIds);
+	}
+
+	pendingChannels.clear();
+	versionGroup.writeEntry(key, versions.toString());
+	serviceGroup.writeEntry(key, serviceIds);
+}
+
+void DvbIncrementalScan::scanFinished()
+{
+	// the signal is queued; it may belong to a previous source
+	if ((scan == NULL) || (sender() != scan)) {
+		return;
+	}
+
+	startNextSource();
+}
@@ -21,11 +21,14 @@
 #ifndef DVBSCAN_H
 #define DVBSCAN_H
 
+#include <QHash>
+#include <QSet>
 #include "dvbchannel.h"
 
 class AtscVctSection;
 class DvbDescriptor;
 class DvbDevice;
+class DvbManager;
 class DvbNitSection;
 class DvbPatEntry;
 class DvbPatSection;
@@ -71,6 +74,30 @@ public:
 	// int number;
 };
 
+// versions of the tables of a transponder which has been scanned (-1 = unknown)
+
+class DvbTransponderVersions
+{
+public:
+	DvbTransponderVersions() : patVersion(-1), sdtVersion(-1), nitVersion(-1) { }
+	~DvbTransponderVersions() { }
+
+	// the services of the transponder are unchanged if the pat and the sdt
+	// (vct for atsc) haven't changed
+	bool matches(const DvbTransponderVersions &other) const
+	{
+		return ((patVersion >= 0) && (patVersion == other.patVersion) &&
+			(sdtVersion == other.sdtVersion));
+	}
+
+	bool fromString(const QString &string); // "pat,sdt,nit"
+	QString toString() const;
+
+	int patVersion;
+	int sdtVersion; // vct for atsc
+	int nitVersion; // of the actual network
+};
+
 class DvbScan : public QObject
 {
 	friend class DvbScanFilter;
@@ -80,14 +107,25 @@ public:
 	DvbScan(DvbDevice *device_, const QString &source_,
 		const QList<DvbTransponder> &transponders_, bool useOtherNit);
 	DvbScan(DvbDevice *device_, const QString &source_, const QString &autoScanSource, bool useOtherNit);
+	// only the transponders whose versions differ from 'knownVersions' (key =
+	// DvbTransponder::toString()) and the ones which are new in the nit are read completely
+	DvbScan(DvbDevice *device_, const QString &source_, const QList<DvbTransponder> &transponders_,
+		const QHash<QString, DvbTransponderVersions> &knownVersions_);
 	~DvbScan();
 
+	// the device scans a part of the transponders (must be called before start())
+	// the channels are merged and the progress covers all devices
+	void addDevice(DvbDevice *device_);
 	void start();
 
 signals:
 	void foundChannels(const QList<DvbPreviewChannel> &channels);
 	void scanProgress(int percentage);
 	void scanFinished();
+	// only emitted for incremental scans (after foundChannels() of the transponder);
+	// 'serviceIds' are the services of the pat (the pmts are only read if 'changed' is true)
+	void transponderScanned(const DvbTransponder &transponder,
+		const DvbTransponderVersions &versions, bool changed, const QList<int> &serviceIds);
 
 private slots:
 	void deviceStateChanged();
@@ -112,8 +150,20 @@ private:
 		ScanTuning
 	};
 
+	DvbScan(DvbScan *owner_, DvbDevice *device_);
+
 	bool startFilter(int pid, FilterType type);
 	void updateState();
+	// drops a device which has been taken over; the scan becomes idle for good
+	void dropDevice();
+	// the following functions are only called for the owner
+	void addChannels(const QList<DvbPreviewChannel> &newChannels);
+	void addTransponder(const DvbTransponder &newTransponder);
+	void wakeUp();
+	void checkFinished();
+	// the timeouts of the filters follow the repetition rates of the tables
+	void addRepetitionTime(FilterType type, int time);
+	int filterTimeout(FilterType type) const; // ms
 
 	void processPat(const DvbPatSection &section);
 	void processPmt(const DvbPmtSection &section, int pid);
@@ -129,10 +179,27 @@ private:
 	bool isLive;
 	bool isAuto;
 	bool useOtherNit;
+	bool incremental;
 
-	// only used if isLive is false
+	// only used if isLive is false; the transponders of the owner are shared
+	// by all devices (transponderIndex = next transponder to be scanned)
 	QList<DvbTransponder> transponders;
 	int transponderIndex;
+	int currentIndex; // index of 'transponder'
+	bool idle; // no transponder left (for the moment)
+
+	DvbScan *owner; // 'this' for the scan which has been created by the user
+	QList<DvbScan *> otherScans;
+	QSet<qint64> foundServices; // network id, transport stream id, service id
+	int repetitionTimes[NitFilter + 1]; // ms, maximum which has been observed
+	QHash<QString, DvbTransponderVersions> knownVersions; // only used by the owner
+	int listedTransponders; // (owner) the transponders after them have been found in the nit
+	bool nitRead; // (owner) incremental scans only read the nit once
+	bool nitBaseline; // (owner) the version of the nit hasn't been known before
+
+	DvbTransponderVersions versions; // of 'transponder'
+	bool versionsChecked;
+	bool tablesChanged; // the pmts are only read if the tables have changed
 
 	State state;
 	QList<DvbPatEntry> patEntries;
@@ -148,4 +215,37 @@ private:
 	int activeFilters;
 };
 
+// rescans the transponders of the channel list (one source after the other) and
+// patches the channel model; the table versions are kept between the scans
+
+class DvbIncrementalScan : public QObject
+{
+	Q_OBJECT
+public:
+	DvbIncrementalScan(DvbManager *manager_, QObject *parent);
+	~DvbIncrementalScan();
+
+	void start(); // the object deletes itself when the scan is finished
+
+private slots:
+	void foundChannels(const QList<DvbPreviewChannel> &channels);
+	void transponderScanned(const DvbTransponder &transponder,
+		const DvbTransponderVersions &versions, bool changed, const QList<int> &serviceIds);
+	void scanFinished();
+	void deviceStateChanged();
+
+private:
+	void startNextSource();
+	void stopScan();
+	void removeMissingChannels(const DvbTransponder &transponder, const QList<int> &serviceIds);
+
+	DvbManager *manager;
+	QMap<QString, QList<DvbTransponder> > sourceTransponders;
+	QString source;
+	QList<DvbTransponder> transponders; // of the channel list (current source)
+	DvbDevice *device;
+	DvbScan *scan;
+	QList<DvbPreviewChannel> pendingChannels; // of the current transponder
+};
+
 #endif /* DVBSCAN_H */
@@ -414,9 +414,11 @@ DvbScanDialog::DvbScanDialog(DvbManager *manager_, QWidget *parent) : QDialog(pa
 
 DvbScanDialog::~DvbScanDialog()
 {
+	delete internal;
 	if (!isLive && device)
 		manager->releaseDevice(device, DvbManager::Exclusive);
-	delete internal;
+	foreach (DvbDevice *otherDevice, otherDevices)
+		manager->releaseDevice(otherDevice, DvbManager::Exclusive);
 }
 
 void DvbScanDialog::scanButtonClicked(bool checked)
@@ -431,8 +433,18 @@ void DvbScanDialog::scanButtonClicked(bool checked)
 		internal = NULL;
 
 		if (!isLive) {
-			manager->releaseDevice(device, DvbManager::Exclusive);
-			setDevice(NULL);
+			if (device != NULL) {
+				disconnect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+				manager->releaseDevice(device, DvbManager::Exclusive);
+				setDevice(NULL);
+			}
+
+			foreach (DvbDevice *otherDevice, otherDevices) {
+				disconnect(otherDevice, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+				manager->releaseDevice(otherDevice, DvbManager::Exclusive);
+			}
+
+			otherDevices.clear();
 		}
 
 		return;
@@ -453,6 +465,7 @@ void DvbScanDialog::scanButtonClicked(bool checked)
 		setDevice(manager->requestExclusiveDevice(source));
 
 		if (device != NULL) {
+			connect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
 			// FIXME ugly
 			QString autoScanSource = manager->getAutoScanSource(source);
 
@@ -462,6 +475,17 @@ void DvbScanDialog::scanButtonClicked(bool checked)
 			} else {
 				internal = new DvbScan(device, source, autoScanSource, otherNitCheckBox->isChecked());
 			}
+
+			// the other idle devices of the source scan in parallel
+			if (manager->isParallelScan()) {
+				DvbDevice *otherDevice;
+
+				while ((otherDevice = manager->requestExclusiveDevice(source)) != NULL) {
+					connect(otherDevice, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+					otherDevices.append(otherDevice);
+					internal->addDevice(otherDevice);
+				}
+			}
 		} else {
 			scanButton->setChecked(false);
 			KMessageBox::sorry(this,
@@ -527,6 +551,25 @@ void DvbScanDialog::scanFinished()
 	}
 }
 
+void DvbScanDialog::deviceStateChanged()
+{
+	// a prioritized request (for example a recording) may take over a device;
+	// it belongs to somebody else then and mustn't be released by the dialog
+	if ((device != NULL) && (device->getDeviceState() == DvbDevice::DeviceReleased)) {
+		disconnect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+		setDevice(NULL);
+	}
+
+	for (int i = (otherDevices.size() - 1); i >= 0; --i) {
+		DvbDevice *otherDevice = otherDevices.at(i);
+
+		if (otherDevice->getDeviceState() == DvbDevice::DeviceReleased) {
+			disconnect(otherDevice, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+			otherDevices.removeAt(i);
+		}
+	}
+}
+
 void DvbScanDialog::updateStatus()
 {
 	if (device->getDeviceState() != DvbDevice::DeviceIdle) {
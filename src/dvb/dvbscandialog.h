@@ -53,6 +53,7 @@ private slots:
 
 	void foundChannels(const QList<DvbPreviewChannel> &channels);
 	void scanFinished();
+	void deviceStateChanged();
 
 	void updateStatus();
 
@@ -81,6 +82,7 @@ private:
 	QTreeView *scanResultsView;
 
 	DvbDevice *device;
+	QList<DvbDevice *> otherDevices; // used by a parallel scan
 	QTimer statusTimer;
 	bool isLive;
 
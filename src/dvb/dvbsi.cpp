@@ -1086,7 +1086,7 @@ void DvbSectionGenerator::initPmt(int pmtPid, const DvbPmtSection &section, cons
 	endSection(size + 4, pmtPid);
 }
 
-QByteArray DvbSectionGenerator::generatePackets()
+const QByteArray &DvbSectionGenerator::generatePackets()
 {
 	char *data = packets.data();
 
@@ -1154,7 +1154,8 @@ void DvbSectionGenerator::endSection(int sectionLength, int pid)
 	versionNumber = (versionNumber + 1) & 0x1f;
 }
 
-DvbPmtParser::DvbPmtParser(const DvbPmtSection &section) : videoPid(-1), teletextPid(-1)
+DvbPmtParser::DvbPmtParser(const DvbPmtSection &section) : videoPid(-1), videoStreamType(-1),
+	teletextPid(-1)
 {
 	for (DvbPmtSectionEntry entry = section.entries(); entry.isValid(); entry.advance()) {
 		QString streamLanguage;
@@ -1241,6 +1242,7 @@ DvbPmtParser::DvbPmtParser(const DvbPmtSection &section) : videoPid(-1), teletex
 		case 0xd1: // Dirac (Ultra HD video)
 			if (videoPid < 0) {
 				videoPid = entry.pid();
+				videoStreamType = entry.streamType();
 			} else {
 				qCInfo(logDvbSi, "More than one video PID");
 			}
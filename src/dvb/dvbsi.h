@@ -306,7 +306,9 @@ public:
 		continuityCounter = 0;
 	}
 
-	QByteArray generatePackets();
+	// the packets are cached; only the continuity counters are updated
+	// the returned data is valid until the next call
+	const QByteArray &generatePackets();
 
 private:
 	char *startSection(int sectionLength);
@@ -317,6 +319,57 @@ private:
 	int continuityCounter;
 };
 
+// decides where pat and pmt are repeated in a generated transport stream:
+// before random access points (so that decoding can start there), at least
+// every 'MaxInterval' of pcr time (streams without video don't have random
+// access points) and at least every 'MaxDistance' packets
+
+class DvbPatPmtRepetition
+{
+public:
+	DvbPatPmtRepetition() : distance(0), lastTime(-1) { }
+	~DvbPatPmtRepetition() { }
+
+	// pat and pmt have just been inserted
+	void reset()
+	{
+		distance = 0;
+		lastTime = -1;
+	}
+
+	// has to be called for every packet; returns true if pat and pmt
+	// should be inserted before the packet
+	// 'time' is the pcr based time (ms); -1 = unknown
+	bool check(bool randomAccessPoint, qint64 time)
+	{
+		if ((lastTime < 0) || (time < lastTime)) {
+			// unknown or discontinuous time line
+			lastTime = time;
+		}
+
+		bool insert = (((randomAccessPoint || ((time - lastTime) >= MaxInterval)) &&
+			(distance >= MinDistance)) || (distance >= MaxDistance));
+
+		if (insert) {
+			distance = 0;
+			lastTime = time;
+		}
+
+		++distance;
+		return insert;
+	}
+
+private:
+	enum {
+		MinDistance = 32, // packets
+		MaxDistance = 2048, // packets
+		MaxInterval = 500 // ms
+	};
+
+	int distance; // packets since the last insertion
+	qint64 lastTime; // time of the last insertion
+};
+
 class DvbPmtParser
 {
 public:
@@ -324,6 +377,7 @@ public:
 	~DvbPmtParser() { }
 
 	int videoPid;
+	int videoStreamType;
 	QList<QPair<int, QString> > audioPids; // QString = language code (may be empty)
 	QList<QPair<int, QString> > subtitlePids; // QString = language code
 	int teletextPid;
@@ -484,6 +538,11 @@ public:
 		initEitSectionEntry(getData() + getLength(), getSize() - getLength());
 	}
 
+	int eventId() const
+	{
+		return (at(0) << 8) | at(1);
+	}
+
 	int startDate() const
 	{
 		return (at(2) << 8) | at(3);
@@ -499,6 +558,11 @@ public:
 		return (at(7) << 16) | (at(8) << 8) | at(9);
 	}
 
+	int runningStatus() const
+	{
+		return (at(10) >> 5);
+	}
+
 	DvbDescriptor descriptors() const
 	{
 		return DvbDescriptor(getData() + 12, getLength() - 12);
@@ -0,0 +1,405 @@
+/*
+ * dvbstreamserver.cpp
+ *
+ * Copyright (C) 2026 Kaffeine developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "../log.h"
+
+#include <QSet>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUrl>
+
+#include "dvbdevice.h"
+#include "dvbmanager.h"
+#include "dvbstreamserver.h"
+#include "dvbstreamserver_p.h"
+
+// data which hasn't been sent to a client yet (~ 2 seconds of a hd channel)
+static const qint64 maxQueuedBytes = (4 * 1024 * 1024);
+static const int maxRequestSize = 8192;
+
+DvbStreamServerClient::DvbStreamServerClient(DvbStreamServer *server_, QTcpSocket *socket_) :
+	QObject(server_), server(server_), socket(socket_), channel(NULL), requestHandled(false),
+	closed(false)
+{
+	socket->setParent(this);
+	connect(socket, SIGNAL(readyRead()), this, SLOT(readyRead()));
+	connect(socket, SIGNAL(disconnected()), this, SLOT(close()));
+}
+
+DvbStreamServerClient::~DvbStreamServerClient()
+{
+}
+
+void DvbStreamServerClient::sendError(const char *status)
+{
+	socket->write(QByteArray("HTTP/1.0 ") + status +
+		"\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n" + status + "\r\n");
+	socket->disconnectFromHost();
+}
+
+void DvbStreamServerClient::startStream(DvbStreamServerChannel *channel_)
+{
+	channel = channel_;
+	socket->write("HTTP/1.0 200 OK\r\nContent-Type: video/mp2t\r\n"
+		"Cache-Control: no-cache\r\nConnection: close\r\n\r\n");
+}
+
+bool DvbStreamServerClient::write(const QByteArray &data)
+{
+	if (socket->bytesToWrite() > maxQueuedBytes) {
+		return false;
+	}
+
+	socket->write(data);
+	return true;
+}
+
+void DvbStreamServerClient::close()
+{
+	if (closed) {
+		return;
+	}
+
+	closed = true;
+	socket->abort();
+	server->removeClient(this);
+	deleteLater();
+}
+
+void DvbStreamServerClient::readyRead()
+{
+	if (requestHandled) {
+		// the rest is ignored
+		socket->readAll();
+		return;
+	}
+
+	request.append(socket->readAll());
+	int end = request.indexOf("\r\n\r\n");
+
+	if (end < 0) {
+		if (request.size() > maxRequestSize) {
+			requestHandled = true;
+			sendError("400 Bad Request");
+		}
+
+		return;
+	}
+
+	requestHandled = true;
+	QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+	request.clear();
+
+	if ((requestLine.size() != 3) || !requestLine.at(1).startsWith('/')) {
+		sendError("400 Bad Request");
+		return;
+	}
+
+	if (requestLine.at(0) != "GET") {
+		sendError("405 Method Not Allowed");
+		return;
+	}
+
+	server->addClient(this, QUrl::fromPercentEncoding(requestLine.at(1).mid(1)));
+}
+
+DvbStreamServerChannel::DvbStreamServerChannel(DvbManager *manager_,
+	const DvbSharedChannel &channel_) : manager(manager_), channel(channel_), device(NULL)
+{
+	connect(&pmtFilter, SIGNAL(pmtSectionChanged(QByteArray)),
+		this, SLOT(pmtSectionChanged(QByteArray)));
+}
+
+DvbStreamServerChannel::~DvbStreamServerChannel()
+{
+	stop();
+}
+
+bool DvbStreamServerChannel::start()
+{
+	// either a device which is already tuned to the transponder or an idle one
+	device = manager->requestDevice(channel->source, channel->transponder,
+		DvbManager::Shared);
+
+	if (device == NULL) {
+		return false;
+	}
+
+	connect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+	pmtFilter.setProgramNumber(channel->serviceId);
+	device->addSectionFilter(channel->pmtPid, &pmtFilter);
+	patGenerator.initPat(channel->transportStreamId, channel->serviceId, channel->pmtPid);
+
+	if (!channel->pmtSectionData.isEmpty()) {
+		// start with the cached pmt; it's updated by the pmt filter
+		pmtSectionChanged(channel->pmtSectionData);
+	}
+
+	return true;
+}
+
+void DvbStreamServerChannel::stop()
+{
+	if (device == NULL) {
+		return;
+	}
+
+	DvbDevice *oldDevice = device;
+	removeFilters();
+	manager->releaseDevice(oldDevice, DvbManager::Shared);
+}
+
+void DvbStreamServerChannel::removeFilters()
+{
+	if (channel->isScrambled && !pmtSectionData.isEmpty()) {
+		device->stopDescrambling(pmtSectionData, this);
+	}
+
+	foreach (int pid, pids) {
+		device->removePidFilter(pid, this);
+	}
+
+	device->removeSectionFilter(channel->pmtPid, &pmtFilter);
+	disconnect(device, SIGNAL(stateChanged()), this, SLOT(deviceStateChanged()));
+	device = NULL;
+	pids.clear();
+	pmtSectionData.clear();
+	patGenerator.reset();
+	pmtGenerator.reset();
+	buffer.clear();
+}
+
+void DvbStreamServerChannel::addClient(DvbStreamServerClient *client)
+{
+	clients.append(client);
+
+	// the new client can start decoding with the next packets
+	if (!pmtSectionData.isEmpty()) {
+		insertPatPmt();
+	}
+}
+
+void DvbStreamServerChannel::removeClient(DvbStreamServerClient *client)
+{
+	clients.removeOne(client);
+}
+
+void DvbStreamServerChannel::deviceStateChanged()
+{
+	if (device->getDeviceState() == DvbDevice::DeviceReleased) {
+		// the device already belongs to somebody else (for example a recording),
+		// so it mustn't be released again
+		removeFilters();
+
+		if (start()) {
+			return;
+		}
+
+		qCWarning(logDvb, "Device of %s has been released; closing the stream clients",
+			qPrintable(channel->name));
+
+		// the last client stops the channel
+		foreach (DvbStreamServerClient *client, clients) {
+			client->close();
+		}
+	}
+}
+
+void DvbStreamServerChannel::pmtSectionChanged(const QByteArray &pmtSectionData_)
+{
+	pmtSectionData = pmtSectionData_;
+	DvbPmtSection pmtSection(pmtSectionData);
+	DvbPmtParser pmtParser(pmtSection);
+	QSet<int> newPids;
+	int pcrPid = pmtSection.pcrPid();
+
+	if (pmtParser.videoPid != -1) {
+		newPids.insert(pmtParser.videoPid);
+	}
+
+	for (int i = 0; i < pmtParser.audioPids.size(); ++i) {
+		newPids.insert(pmtParser.audioPids.at(i).first);
+	}
+
+	for (int i = 0; i < pmtParser.subtitlePids.size(); ++i) {
+		newPids.insert(pmtParser.subtitlePids.at(i).first);
+	}
+
+	if (pmtParser.teletextPid != -1) {
+		newPids.insert(pmtParser.teletextPid);
+	}
+
+	if (pcrPid != 0x1fff) {
+		newPids.insert(pcrPid);
+	}
+
+	for (int i = 0; i < pids.size(); ++i) {
+		int pid = pids.at(i);
+
+		if (!newPids.remove(pid)) {
+			device->removePidFilter(pid, this);
+			pids.removeAt(i);
+			--i;
+		}
+	}
+
+	foreach (int pid, newPids) {
+		device->addPidFilter(pid, this);
+		pids.append(pid);
+	}
+
+	pmtGenerator.initPmt(channel->pmtPid, pmtSection, pids);
+	seekIndex.setStreams(pmtParser.videoPid, pmtParser.videoStreamType, pcrPid);
+	insertPatPmt();
+
+	if (channel->isScrambled) {
+		device->startDescrambling(pmtSectionData, this);
+	}
+}
+
+void DvbStreamServerChannel::insertPatPmt()
+{
+	buffer.append(patGenerator.generatePackets());
+	buffer.append(pmtGenerator.generatePackets());
+	patPmtRepetition.reset();
+}
+
+void DvbStreamServerChannel::processData(const char data[188])
+{
+	seekIndex.processPcr(data);
+
+	if (patPmtRepetition.check(seekIndex.isRandomAccessPoint(data), seekIndex.time())) {
+		insertPatPmt();
+	}
+
+	buffer.append(data, 188);
+
+	if (buffer.size() < (87 * 188)) {
+		return;
+	}
+
+	// every client has its own (bounded) queue in the socket
+	foreach (DvbStreamServerClient *client, clients) {
+		if (!client->write(buffer)) {
+			qCWarning(logDvb, "Dropping a stream client of %s which is too slow",
+				qPrintable(channel->name));
+			client->close();
+		}
+	}
+
+	// keeps the reserved capacity
+	buffer.resize(0);
+}
+
+DvbStreamServer::DvbStreamServer(DvbManager *manager_, int port, QObject *parent) :
+	QObject(parent), manager(manager_)
+{
+	tcpServer = new QTcpServer(this);
+	connect(tcpServer, SIGNAL(newConnection()), this, SLOT(newConnection()));
+
+	if (!tcpServer->listen(QHostAddress::LocalHost, quint16(port))) {
+		qCWarning(logDvb, "Cannot start the stream server on port %d: %s", port,
+			qPrintable(tcpServer->errorString()));
+	}
+}
+
+DvbStreamServer::~DvbStreamServer()
+{
+	tcpServer->close();
+
+	// the devices have to be released before the manager deletes them
+	qDeleteAll(clients);
+	qDeleteAll(channels);
+}
+
+void DvbStreamServer::addClient(DvbStreamServerClient *client, const QString &path)
+{
+	QString name = path;
+
+	if (name.endsWith(QLatin1String(".ts"))) {
+		name.chop(3);
+	}
+
+	bool ok;
+	int number = name.toInt(&ok);
+	DvbSharedChannel channel;
+
+	if (ok) {
+		channel = manager->getChannelModel()->findChannelByNumber(number);
+	} else {
+		channel = manager->getChannelModel()->findChannelByName(name);
+	}
+
+	if (channel.constData() == NULL) {
+		client->sendError("404 Not Found");
+		return;
+	}
+
+	DvbStreamServerChannel *streamChannel = NULL;
+
+	foreach (DvbStreamServerChannel *it, channels) {
+		if (it->getChannel() == channel) {
+			streamChannel = it;
+			break;
+		}
+	}
+
+	if (streamChannel == NULL) {
+		streamChannel = new DvbStreamServerChannel(manager, channel);
+
+		if (!streamChannel->start()) {
+			delete streamChannel;
+			client->sendError("503 Service Unavailable");
+			return;
+		}
+
+		channels.append(streamChannel);
+		qCDebug(logDvb, "Streaming %s", qPrintable(channel->name));
+	}
+
+	client->startStream(streamChannel);
+	streamChannel->addClient(client);
+}
+
+void DvbStreamServer::removeClient(DvbStreamServerClient *client)
+{
+	clients.removeOne(client);
+	DvbStreamServerChannel *streamChannel = client->getChannel();
+
+	if (streamChannel == NULL) {
+		return;
+	}
+
+	streamChannel->removeClient(client);
+
+	if (streamChannel->isEmpty()) {
+		// may be called from the pid filter of the channel
+		channels.removeOne(streamChannel);
+		streamChannel->stop();
+		streamChannel->deleteLater();
+	}
+}
+
+void DvbStreamServer::newConnection()
+{
+	while (tcpServer->hasPendingConnections()) {
+		clients.append(new DvbStreamServerClient(this, tcpServer->nextPendingConnection()));
+	}
+}
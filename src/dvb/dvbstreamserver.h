@@ -0,0 +1,56 @@
+/*
+ * dvbstreamserver.h
+ *
+ * Copyright (C) 2026 Kaffeine developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef DVBSTREAMSERVER_H
+#define DVBSTREAMSERVER_H
+
+#include <QObject>
+
+class QTcpServer;
+class DvbManager;
+class DvbStreamServerChannel;
+class DvbStreamServerClient;
+
+// serves channels as transport streams over http on localhost, for example
+// "http://localhost:<port>/<channel number or name>"
+// all clients of a channel are fed by the same pid filters of one device
+
+class DvbStreamServer : public QObject
+{
+	Q_OBJECT
+public:
+	DvbStreamServer(DvbManager *manager_, int port, QObject *parent);
+	~DvbStreamServer();
+
+	// called by the client once the request has been received
+	void addClient(DvbStreamServerClient *client, const QString &path);
+	void removeClient(DvbStreamServerClient *client);
+
+private slots:
+	void newConnection();
+
+private:
+	DvbManager *manager;
+	QTcpServer *tcpServer;
+	QList<DvbStreamServerClient *> clients;
+	QList<DvbStreamServerChannel *> channels;
+};
+
+#endif /* DVBSTREAMSERVER_H */
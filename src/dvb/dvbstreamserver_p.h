@@ -0,0 +1,115 @@
+/*
+ * dvbstreamserver_p.h
+ *
+ * Copyright (C) 2026 Kaffeine developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef DVBSTREAMSERVER_P_H
+#define DVBSTREAMSERVER_P_H
+
+#include "../seekindex.h"
+#include "dvbbackenddevice.h"
+#include "dvbchannel.h"
+#include "dvbsi.h"
+
+class QTcpSocket;
+class DvbDevice;
+class DvbManager;
+class DvbStreamServer;
+class DvbStreamServerChannel;
+
+class DvbStreamServerClient : public QObject
+{
+	Q_OBJECT
+public:
+	DvbStreamServerClient(DvbStreamServer *server_, QTcpSocket *socket_);
+	~DvbStreamServerClient();
+
+	void sendError(const char *status); // for example "404 Not Found"
+	void startStream(DvbStreamServerChannel *channel_);
+	// returns false if the client can't keep up (the data isn't queued then)
+	bool write(const QByteArray &data);
+
+	DvbStreamServerChannel *getChannel() const
+	{
+		return channel;
+	}
+
+public slots:
+	// the client is deleted later
+	void close();
+
+private slots:
+	void readyRead();
+
+private:
+	DvbStreamServer *server;
+	QTcpSocket *socket;
+	DvbStreamServerChannel *channel;
+	QByteArray request;
+	bool requestHandled;
+	bool closed;
+};
+
+class DvbStreamServerChannel : public QObject, private DvbPidFilter
+{
+	Q_OBJECT
+public:
+	DvbStreamServerChannel(DvbManager *manager_, const DvbSharedChannel &channel_);
+	~DvbStreamServerChannel();
+
+	DvbSharedChannel getChannel() const
+	{
+		return channel;
+	}
+
+	bool start(); // returns false if there's no suitable device
+	void stop();
+
+	void addClient(DvbStreamServerClient *client);
+	void removeClient(DvbStreamServerClient *client);
+
+	bool isEmpty() const
+	{
+		return clients.isEmpty();
+	}
+
+private slots:
+	void deviceStateChanged();
+	void pmtSectionChanged(const QByteArray &pmtSectionData_);
+
+private:
+	void processData(const char data[188]) override;
+	void removeFilters(); // doesn't release the device
+	void insertPatPmt();
+
+	DvbManager *manager;
+	DvbSharedChannel channel;
+	DvbDevice *device;
+	QList<int> pids;
+	QList<DvbStreamServerClient *> clients;
+	DvbPmtFilter pmtFilter;
+	QByteArray pmtSectionData;
+	DvbSectionGenerator patGenerator;
+	DvbSectionGenerator pmtGenerator;
+	DvbPatPmtRepetition patPmtRepetition;
+	// only used to find the random access points and for the pcr time
+	SeekIndexWriter seekIndex;
+	QByteArray buffer;
+};
+
+#endif /* DVBSTREAMSERVER_P_H */
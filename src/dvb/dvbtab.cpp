@@ -35,6 +35,7 @@
 #include <QToolButton>
 
 #include "../osdwidget.h"
+#include "../seekindex.h"
 #include "dvbchanneldialog.h"
 #include "dvbconfigdialog.h"
 #include "dvbepg.h"
@@ -77,6 +78,7 @@ void DvbTimeShiftCleaner::run()
 	// delete files asynchronously because it may block for several seconds
 	foreach (const QString &file, files) {
 		QFile::remove(path + QLatin1Char('/') + file);
+		QFile::remove(SeekIndexWriter::indexFileName(path + QLatin1Char('/') + file));
 	}
 }
 
@@ -443,7 +445,7 @@ void DvbTab::instantRecord(bool checked)
 
 		DvbRecording recording;
 		QList<DvbSharedEpgEntry> epgEntries =
-			manager->getEpgModel()->getCurrentNext(channel);
+			manager->getEpgModel()->getCurrentNext().value(channel);
 
 		if (!epgEntries.isEmpty()) {
 			recording.name = epgEntries.at(0)->title();
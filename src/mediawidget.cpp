@@ -744,6 +744,11 @@ MediaWidget::PlaybackStatus MediaWidget::getPlaybackStatus() const
 	return backend->getPlaybackStatus();
 }
 
+bool MediaWidget::supportsStreams() const
+{
+	return backend->supportsStreams();
+}
+
 int MediaWidget::getVolume() const
 {
 	return volumeSlider->value();
@@ -122,6 +122,7 @@ public:
 	PlaybackStatus getPlaybackStatus() const;
 	int getPosition() const; // milliseconds
 	int getVolume() const; // 0 - 100
+	bool supportsStreams() const; // see MediaSource::getStream()
 
 	void play(); // (re-)starts the current media
 	void togglePause();
@@ -259,6 +260,28 @@ private:
 	bool showElapsedTime;
 };
 
+// data which is passed in-process to the backend (instead of opening an url)
+// open(), read(), seek() and close() are called from a backend thread
+
+class MediaStream
+{
+public:
+	MediaStream() { }
+	virtual ~MediaStream() { }
+
+	virtual bool open() = 0;
+	// blocks until data is available; returns 0 after abort()
+	virtual qint64 read(char *data, qint64 size) = 0;
+	virtual bool seek(quint64 offset) = 0;
+	virtual void close() = 0;
+
+	// wakes up a blocked read(); the backend calls it before stopping playback
+	virtual void abort() = 0;
+	// times in milliseconds; the stream provides its own time line
+	virtual void getCurrentTotalTime(int &currentTime, int &totalTime) const = 0;
+	virtual void seekTime(int time) = 0;
+};
+
 class MediaSource
 {
 public:
@@ -280,6 +303,8 @@ public:
 
 	virtual Type getType() const { return Url; }
 	virtual QUrl getUrl() const { return QUrl(); }
+	// only used if the backend supports streams; otherwise getUrl() is used
+	virtual MediaStream *getStream() const { return NULL; }
 	virtual void validateCurrentTotalTime(int &, int &) const { }
 	virtual bool hideCurrentTotalTime() const { return false; }
 	virtual bool overrideAudioStreams() const { return false; }
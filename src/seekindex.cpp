@@ -0,0 +1,353 @@
+/*
+ * seekindex.cpp
+ *
+ * Copyright (C) 2026 Kaffeine developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "log.h"
+
+#include <QtEndian>
+#include <string.h>
+
+#include "seekindex.h"
+
+// file format: magic, version, entries (all values big endian)
+// entry: offset (64 bit), time (32 bit, ms), flags (32 bit)
+
+static const char seekIndexMagic[4] = { 'K', 'S', 'I', 'X' };
+static const int seekIndexVersion = 1;
+static const int seekIndexHeaderSize = 8;
+static const int seekIndexEntrySize = 16;
+
+SeekIndexWriter::SeekIndexWriter() : videoPid(-1), pcrPid(-1), videoCodec(OtherVideo),
+	lastPcrBase(0), elapsedTicks(0), currentTime(-1), lastEntryTime(-1)
+{
+}
+
+SeekIndexWriter::~SeekIndexWriter()
+{
+	close();
+}
+
+bool SeekIndexWriter::open(const QString &fileName)
+{
+	close();
+	file.setFileName(fileName);
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qCWarning(logMediaWidget, "Cannot open file %s", qPrintable(fileName));
+		return false;
+	}
+
+	char header[seekIndexHeaderSize];
+	memcpy(header, seekIndexMagic, 4);
+	qToBigEndian<quint32>(seekIndexVersion, reinterpret_cast<uchar *>(header + 4));
+	file.write(header, seekIndexHeaderSize);
+
+	videoPid = -1;
+	pcrPid = -1;
+	videoCodec = OtherVideo;
+	resetTime();
+	return true;
+}
+
+void SeekIndexWriter::close()
+{
+	if (file.isOpen()) {
+		file.write(pendingData);
+		pendingData.clear();
+		file.close();
+	}
+}
+
+void SeekIndexWriter::setStreams(int videoPid_, int videoStreamType, int pcrPid_)
+{
+	videoPid = videoPid_;
+	pcrPid = pcrPid_;
+
+	switch (videoStreamType) {
+	case 0x01:
+	case 0x02:
+		videoCodec = Mpeg2Video;
+		break;
+	case 0x1b:
+		videoCodec = H264Video;
+		break;
+	case 0x24:
+		videoCodec = HevcVideo;
+		break;
+	default:
+		videoCodec = OtherVideo;
+		break;
+	}
+}
+
+void SeekIndexWriter::processPacket(const char packet[188], qint64 offset)
+{
+	if (!file.isOpen()) {
+		return;
+	}
+
+	if (processPcr(packet) && ((lastEntryTime < 0) || ((currentTime - lastEntryTime) >= 1000))) {
+		addEntry(offset, 0);
+	}
+
+	if ((currentTime >= 0) && isRandomAccessPoint(packet)) {
+		addEntry(offset, SeekIndexEntry::RandomAccessPoint);
+	}
+}
+
+bool SeekIndexWriter::processPcr(const char packet[188])
+{
+	const uchar *data = reinterpret_cast<const uchar *>(packet);
+	int pid = ((data[1] << 8) | data[2]) & 0x1fff;
+
+	if ((pid != pcrPid) || ((data[3] & 0x20) == 0)) {
+		return false;
+	}
+
+	int adaptationFieldLength = data[4];
+
+	if ((adaptationFieldLength < 7) || (adaptationFieldLength > 183) ||
+	    ((data[5] & 0x10) == 0)) {
+		return false;
+	}
+
+	qint64 pcrBase = ((qint64(data[6]) << 25) | (data[7] << 17) |
+		(data[8] << 9) | (data[9] << 1) | (data[10] >> 7));
+	updateTime(pcrBase);
+	return true;
+}
+
+bool SeekIndexWriter::isRandomAccessPoint(const char packet[188]) const
+{
+	const uchar *data = reinterpret_cast<const uchar *>(packet);
+	int pid = ((data[1] << 8) | data[2]) & 0x1fff;
+
+	if ((pid != videoPid) || ((data[1] & 0x40) == 0)) {
+		return false;
+	}
+
+	int adaptationFieldControl = ((data[3] >> 4) & 0x03);
+	int payloadStart = 4;
+
+	if ((adaptationFieldControl & 0x02) != 0) {
+		int adaptationFieldLength = data[4];
+
+		if ((adaptationFieldLength > 0) && (adaptationFieldLength <= 183) &&
+		    ((data[5] & 0x40) != 0)) {
+			// random access indicator
+			return true;
+		}
+
+		payloadStart = 5 + adaptationFieldLength;
+	}
+
+	if (((adaptationFieldControl & 0x01) == 0) || (payloadStart >= 188)) {
+		return false;
+	}
+
+	return containsRandomAccessPoint(packet + payloadStart, 188 - payloadStart);
+}
+
+void SeekIndexWriter::updateTime(qint64 pcrBase)
+{
+	if (currentTime < 0) {
+		elapsedTicks = 0;
+		currentTime = 0;
+		lastPcrBase = pcrBase;
+		return;
+	}
+
+	qint64 delta = (pcrBase - lastPcrBase);
+
+	if (delta < 0) {
+		// wrap around of the 33 bit counter
+		delta += (Q_INT64_C(1) << 33);
+	}
+
+	if (delta > (10 * 90000)) {
+		// discontinuity; the time continues where it stopped
+		delta = 0;
+	}
+
+	lastPcrBase = pcrBase;
+	elapsedTicks += delta;
+	currentTime = (elapsedTicks / 90);
+}
+
+bool SeekIndexWriter::containsRandomAccessPoint(const char *data, int size) const
+{
+	const uchar *payload = reinterpret_cast<const uchar *>(data);
+
+	// skip the pes header
+	if ((size < 9) || (payload[0] != 0x00) || (payload[1] != 0x00) || (payload[2] != 0x01)) {
+		return false;
+	}
+
+	int headerSize = (9 + payload[8]);
+
+	for (int i = headerSize; (i + 3) < size; ++i) {
+		if ((payload[i] != 0x00) || (payload[i + 1] != 0x00) || (payload[i + 2] != 0x01)) {
+			continue;
+		}
+
+		int code = payload[i + 3];
+
+		switch (videoCodec) {
+		case Mpeg2Video:
+			if (code == 0xb3) {
+				// sequence header
+				return true;
+			}
+
+			break;
+		case H264Video:
+			if (((code & 0x1f) == 5) || ((code & 0x1f) == 7)) {
+				// idr slice or sequence parameter set
+				return true;
+			}
+
+			break;
+		case HevcVideo: {
+			int nalType = ((code >> 1) & 0x3f);
+
+			if (((nalType >= 16) && (nalType <= 21)) || (nalType == 32) ||
+			    (nalType == 33)) {
+				// irap picture, video or sequence parameter set
+				return true;
+			}
+
+			break;
+		    }
+		case OtherVideo:
+			return false;
+		}
+	}
+
+	return false;
+}
+
+void SeekIndexWriter::addEntry(qint64 offset, quint32 flags)
+{
+	char entry[seekIndexEntrySize];
+	qToBigEndian<quint64>(offset, reinterpret_cast<uchar *>(entry));
+	qToBigEndian<quint32>(quint32(currentTime), reinterpret_cast<uchar *>(entry + 8));
+	qToBigEndian<quint32>(flags, reinterpret_cast<uchar *>(entry + 12));
+	pendingData.append(entry, seekIndexEntrySize);
+	lastEntryTime = currentTime;
+
+	if (pendingData.size() >= (64 * seekIndexEntrySize)) {
+		file.write(pendingData);
+		file.flush();
+		pendingData.clear();
+	}
+}
+
+bool SeekIndex::open(const QString &fileName_)
+{
+	close();
+	QFile file(fileName_);
+
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	QByteArray header = file.read(seekIndexHeaderSize);
+
+	if ((header.size() != seekIndexHeaderSize) || !header.startsWith(QByteArray(seekIndexMagic, 4)) ||
+	    (qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(header.constData() + 4)) !=
+	     quint32(seekIndexVersion))) {
+		qCWarning(logMediaWidget, "Invalid seek index %s", qPrintable(fileName_));
+		return false;
+	}
+
+	fileName = fileName_;
+	readOffset = seekIndexHeaderSize;
+	update();
+	return true;
+}
+
+void SeekIndex::close()
+{
+	fileName.clear();
+	readOffset = 0;
+	entries.clear();
+	otherEntries.clear();
+}
+
+void SeekIndex::update()
+{
+	if (fileName.isEmpty()) {
+		return;
+	}
+
+	QFile file(fileName);
+
+	if (!file.open(QIODevice::ReadOnly) || !file.seek(readOffset)) {
+		return;
+	}
+
+	QByteArray data = file.readAll();
+	int size = (data.size() - (data.size() % seekIndexEntrySize));
+	const uchar *entryData = reinterpret_cast<const uchar *>(data.constData());
+	readOffset += size;
+
+	for (int i = 0; i < size; i += seekIndexEntrySize) {
+		SeekIndexEntry entry;
+		entry.offset = qint64(qFromBigEndian<quint64>(entryData + i));
+		entry.time = qFromBigEndian<quint32>(entryData + i + 8);
+		entry.flags = qFromBigEndian<quint32>(entryData + i + 12);
+
+		if ((entry.flags & SeekIndexEntry::RandomAccessPoint) != 0) {
+			entries.append(entry);
+		} else {
+			otherEntries.append(entry);
+		}
+	}
+}
+
+qint64 SeekIndex::findOffset(qint64 time) const
+{
+	// streams without random access points (for example radio) use the other entries
+	const QVector<SeekIndexEntry> &searchedEntries =
+		(entries.isEmpty() ? otherEntries : entries);
+
+	if (searchedEntries.isEmpty() || (time < 0)) {
+		return -1;
+	}
+
+	// binary search for the last entry with entry.time <= time
+	int begin = 0;
+	int end = searchedEntries.size();
+
+	while (begin < end) {
+		int middle = ((begin + end) / 2);
+
+		if (searchedEntries.at(middle).time <= time) {
+			begin = (middle + 1);
+		} else {
+			end = middle;
+		}
+	}
+
+	if (begin == 0) {
+		return searchedEntries.at(0).offset;
+	}
+
+	return searchedEntries.at(begin - 1).offset;
+}
@@ -0,0 +1,141 @@
+/*
+ * seekindex.h
+ *
+ * Copyright (C) 2026 Kaffeine developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef SEEKINDEX_H
+#define SEEKINDEX_H
+
+#include <QFile>
+#include <QVector>
+
+// sidecar index of a transport stream file ("<file>.idx")
+// every entry maps a time (ms since the first pcr) to a byte offset; entries
+// are added at random access points of the video stream and once per second
+
+class SeekIndexEntry
+{
+public:
+	enum Flag {
+		RandomAccessPoint = 0x1
+	};
+
+	qint64 offset;
+	quint32 time; // ms
+	quint32 flags;
+};
+
+Q_DECLARE_TYPEINFO(SeekIndexEntry, Q_PRIMITIVE_TYPE);
+
+class SeekIndexWriter
+{
+public:
+	SeekIndexWriter();
+	~SeekIndexWriter();
+
+	static QString indexFileName(const QString &fileName)
+	{
+		return fileName + QLatin1String(".idx");
+	}
+
+	bool open(const QString &fileName); // file name of the index
+	void close();
+
+	bool isOpen() const
+	{
+		return file.isOpen();
+	}
+
+	// 'videoStreamType' is the stream type of the pmt; -1 = no video / no pcr
+	void setStreams(int videoPid_, int videoStreamType, int pcrPid_);
+	// 'offset' is the position of the packet in the transport stream file
+	void processPacket(const char packet[188], qint64 offset);
+	// only updates time(); returns true if the packet contains a pcr
+	bool processPcr(const char packet[188]);
+
+	// restarts the time line (for example after a channel change)
+	void resetTime()
+	{
+		currentTime = -1;
+		lastEntryTime = -1;
+	}
+
+	bool hasVideo() const
+	{
+		return (videoPid >= 0);
+	}
+
+	// true if a video frame which can be decoded independently starts in the packet
+	bool isRandomAccessPoint(const char packet[188]) const;
+
+	// ms since the first pcr; -1 if no pcr has been seen yet
+	qint64 time() const
+	{
+		return currentTime;
+	}
+
+private:
+	enum VideoCodec {
+		OtherVideo,
+		Mpeg2Video,
+		H264Video,
+		HevcVideo
+	};
+
+	void updateTime(qint64 pcrBase);
+	bool containsRandomAccessPoint(const char *data, int size) const;
+	void addEntry(qint64 offset, quint32 flags);
+
+	QFile file;
+	QByteArray pendingData;
+	int videoPid;
+	int pcrPid;
+	VideoCodec videoCodec;
+	qint64 lastPcrBase; // 90 kHz
+	qint64 elapsedTicks; // 90 kHz, since the first pcr
+	qint64 currentTime; // ms, -1 = no pcr seen yet
+	qint64 lastEntryTime; // ms
+};
+
+class SeekIndex
+{
+public:
+	SeekIndex() : readOffset(0) { }
+	~SeekIndex() { }
+
+	bool open(const QString &fileName_); // file name of the index
+	void close();
+
+	bool isOpen() const
+	{
+		return !fileName.isEmpty();
+	}
+
+	// reads entries which have been added in the meantime (growing files)
+	void update();
+	// offset of the last random access point at or before 'time' (ms); -1 if unknown
+	qint64 findOffset(qint64 time) const;
+
+private:
+	QString fileName;
+	qint64 readOffset;
+	QVector<SeekIndexEntry> entries; // random access points (or all if there are none)
+	QVector<SeekIndexEntry> otherEntries;
+};
+
+#endif /* SEEKINDEX_H */
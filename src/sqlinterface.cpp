@@ -94,6 +94,23 @@ void SqlInterface::sqlInit(const QString &tableName, const QStringList &columnNa
 		createTable = true;
 		requestSubmission();
 	} else {
+		// columns which were added later are missing in older tables
+
+		QStringList existingColumnNames;
+
+		for (QSqlQuery query = sqlHelper->exec(QLatin1String("PRAGMA table_info(") +
+		     tableName + QLatin1Char(')')); query.next();) {
+			existingColumnNames.append(query.value(1).toString());
+		}
+
+		foreach (const QString &columnName, columnNames) {
+			if (!existingColumnNames.isEmpty() &&
+			    !existingColumnNames.contains(columnName, Qt::CaseInsensitive)) {
+				sqlHelper->exec(QLatin1String("ALTER TABLE ") + tableName +
+					QLatin1String(" ADD COLUMN ") + columnName);
+			}
+		}
+
 		// queries can only be prepared if the table exists
 		insertQuery = sqlHelper->prepare(insertStatement);
 		updateQuery = sqlHelper->prepare(updateStatement);